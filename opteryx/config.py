@@ -30,6 +30,14 @@ except Exception as exception:  # it doesn't matter why - just use the defaults
 INTERNAL_BATCH_SIZE: int = int(_config.get("INTERNAL_BATCH_SIZE", 500))
 # The maximum number of records to create in a CROSS JOIN frame
 MAX_JOIN_SIZE: int = int(_config.get("MAX_JOIN_SIZE", 1000000))
+# The maximum number of threads to use for parallel operators (e.g. aggregations)
+MAX_WORKER_THREADS: int = int(_config.get("MAX_WORKER_THREADS", pyarrow.cpu_count()))
+# The approximate memory (in bytes) an operator can use before spilling to disk
+MAX_OPERATOR_MEMORY: int = int(_config.get("MAX_OPERATOR_MEMORY", 1024 * 1024 * 1024))
+# The folder to write spill files to - the default is the system temp folder
+SPILL_PATH: str = _config.get("SPILL_PATH")
+# The folder to save blob manifests (zone maps) to - manifests aren't used if not set
+MANIFEST_PATH: str = _config.get("MANIFEST_PATH")
 # The maximum number of processors to use for multi processing
 MAX_SUB_PROCESSES: int = int(_config.get("MAX_SUB_PROCESSES", pyarrow.io_thread_count()))
 # The number of bytes to allocate for each processor
@@ -29,8 +29,7 @@ from opteryx.engine.functions import number_functions
 from opteryx.engine.functions import other_functions
 from opteryx.engine.functions import string_functions
 from opteryx.exceptions import SqlError
-from opteryx.third_party.date_trunc import date_trunc
-from opteryx.utils import dates
+from opteryx.utils.arrow import as_array, map_distinct
 
 
 def get_random():
@@ -43,28 +42,11 @@ def get_random():
         return 0
 
 
-def get_md5(item):
-    """calculate MD5 hash of a value"""
-    # this is slow but expected to not have a lot of use
-    import hashlib  # delay the import - it's rarely needed
-
-    return hashlib.md5(str(item).encode()).hexdigest()  # nosec - meant to be MD5
-
-
 def get_version():
     """return opteryx version"""
     return opteryx.__version__
 
 
-def _get(value, item):
-    try:
-        if isinstance(value, dict):
-            return value.get(item)
-        return value[int(item)]
-    except (KeyError, IndexError, TypeError):
-        return None
-
-
 VECTORIZED_CASTERS = {
     "BOOLEAN": "bool",
     "NUMERIC": "float64",
@@ -72,9 +54,11 @@ VECTORIZED_CASTERS = {
 }
 
 ITERATIVE_CASTERS = {
-    "TIMESTAMP": lambda x: numpy.datetime64(int(x), "s")
-    if isinstance(x, numpy.int64)
-    else numpy.datetime64(x),
+    "TIMESTAMP": lambda x: (
+        numpy.datetime64(int(x), "s")
+        if isinstance(x, numpy.int64)
+        else numpy.datetime64(x)
+    ),
 }
 
 
@@ -93,23 +77,44 @@ def cast(_type):
     raise SqlError(f"Unable to cast values in column to `{_type}`")
 
 
+def _try_cast_values(values, target):
+    """cast each of the values on its own, the values which can't be cast are null"""
+    cast = []
+    for index in range(len(values)):
+        try:
+            cast.append(values.slice(index, 1).cast(target))
+        except (pyarrow.ArrowInvalid, ArrowNotImplementedError):
+            cast.append(pyarrow.nulls(1, target))
+    return pyarrow.concat_arrays(cast) if cast else pyarrow.array([], target)
+
+
 def try_cast(_type):
-    """cast a column to a specified type"""
+    """cast a column to a specified type, values which can't be cast are null"""
     casters = {
-        "BOOLEAN": bool,
-        "NUMERIC": float,
-        "VARCHAR": str,
-        "TIMESTAMP": dates.parse_iso,
+        "BOOLEAN": pyarrow.bool_(),
+        "NUMERIC": pyarrow.float64(),
+        "VARCHAR": pyarrow.string(),
+        "TIMESTAMP": pyarrow.timestamp("us"),
     }
     if _type in casters:
+        target = casters[_type]
 
         def _inner(arr):
-            caster = casters[_type]
-            for i in arr:
-                try:
-                    yield [caster(i)]
-                except (ValueError, TypeError, ArrowNotImplementedError):
-                    yield [None]
+            arr = as_array(arr)
+            if pyarrow.types.is_dictionary(arr.type):
+                arr = arr.dictionary_decode()
+            try:
+                return compute.cast(arr, target)
+            except ArrowNotImplementedError:
+                # values of this type can't be cast to the target type
+                return pyarrow.nulls(len(arr), target)
+            except pyarrow.ArrowInvalid:
+                # some of the values can't be cast, cast each of the distinct values
+                # so the result for a value doesn't depend on the other values
+                encoded = arr.dictionary_encode()
+                return _try_cast_values(encoded.dictionary, target).take(
+                    encoded.indices
+                )
 
         return _inner
     raise SqlError(f"Unable to cast values in column to `{_type}`")
@@ -132,49 +137,69 @@ def _repeat_no_parameters(func):
     return _inner
 
 
-def _iterate_single_parameter(func):
-    def _inner(array):
-        if isinstance(array, str):
-            array = [array]
-        for item in array:
-            yield [func(item)]
-
-    return _inner
-
-
-def _iterate_double_parameter(func):
+def _numpy_parameters(func):
     """
-    for functions called FUNCTION(field, literal)
+    for functions written for numpy arrays, the arrays are passed to these functions
+    as numpy arrays, other functions are passed Arrow arrays
     """
 
-    def _inner(array, literal):
-        if isinstance(array, str):
-            array = [array]
-        for item in array:
-            yield [func(item, literal)]
+    def _inner(*args):
+        return func(
+            *[
+                (
+                    arg.to_numpy(zero_copy_only=False)
+                    if isinstance(arg, (pyarrow.Array, pyarrow.ChunkedArray))
+                    else arg
+                )
+                for arg in args
+            ]
+        )
 
     return _inner
 
 
-def _iterate_double_parameter_field_second(func):
-    """
-    for functions called FUNCTION(LITERAL, FIELD)
-    """
-
-    def _inner(literal, array):
-        if isinstance(array, str):
-            array = [array]
-        for item in array:
-            yield [func(literal, item)]
-
-    return _inner
-
+def get_len(arr):
+    """the number of characters, bytes, items or fields in each value"""
+    arr = as_array(arr)
+    if pyarrow.types.is_string(arr.type) or pyarrow.types.is_large_string(arr.type):
+        return compute.utf8_length(arr).cast(pyarrow.int64())
+    if pyarrow.types.is_binary(arr.type) or pyarrow.types.is_large_binary(arr.type):
+        return compute.binary_length(arr).cast(pyarrow.int64())
+    if (
+        pyarrow.types.is_list(arr.type)
+        or pyarrow.types.is_large_list(arr.type)
+        or pyarrow.types.is_fixed_size_list(arr.type)
+    ):
+        return compute.list_value_length(arr).cast(pyarrow.int64())
+    if pyarrow.types.is_struct(arr.type):
+        return compute.if_else(
+            compute.is_valid(arr),
+            arr.type.num_fields,
+            pyarrow.scalar(None, pyarrow.int64()),
+        )
+    # other values don't have a length
+    return pyarrow.nulls(len(arr), pyarrow.int64())
+
+
+def get_hash(arr):
+    """hash each of the values, nulls are hashed as None"""
+    return map_distinct(
+        lambda value: format(CityHash64(str(value)), "X"), arr, pyarrow.string()
+    )
+
+
+def get_md5(arr):
+    """calculate the MD5 hash of each of the values"""
+    # this is slow but expected to not have a lot of use
+    import hashlib  # delay the import - it's rarely needed
 
-def get_len(obj):
-    """len, but nullsafe"""
-    if hasattr(obj, "__len__"):
-        return len(obj)
-    return None
+    return map_distinct(
+        lambda value: hashlib.md5(
+            str(value).encode()
+        ).hexdigest(),  # nosec - meant to be MD5
+        arr,
+        pyarrow.string(),
+    )
 
 
 def _raise_exception(text):
@@ -188,34 +213,34 @@ def _raise_exception(text):
 FUNCTIONS = {
     "VERSION": (None, _repeat_no_parameters(get_version),),
     # TYPE CONVERSION
-    "TIMESTAMP": (None, cast("TIMESTAMP"),),
+    "TIMESTAMP": (None, _numpy_parameters(cast("TIMESTAMP")),),
     "BOOLEAN": (None, cast("BOOLEAN"),),
     "NUMERIC": (None, cast("NUMERIC"),),
     "VARCHAR": (None, cast("VARCHAR"),),
     "STRING": (None, cast("VARCHAR"),),  # alias for VARCHAR
-    "TRY_TIMESTAMP": (None, try_cast("TIMESTAMP"),),
-    "TRY_BOOLEAN": (None, try_cast("BOOLEAN"),),
-    "TRY_NUMERIC": (None, try_cast("NUMERIC"),),
-    "TRY_VARCHAR": (None, try_cast("VARCHAR"),),
-    "TRY_STRING": (None, try_cast("VARCHAR"),),  # alias for VARCHAR
+    "TRY_TIMESTAMP": (pyarrow.timestamp("us"), try_cast("TIMESTAMP"),),
+    "TRY_BOOLEAN": (pyarrow.bool_(), try_cast("BOOLEAN"),),
+    "TRY_NUMERIC": (pyarrow.float64(), try_cast("NUMERIC"),),
+    "TRY_VARCHAR": (pyarrow.string(), try_cast("VARCHAR"),),
+    "TRY_STRING": (pyarrow.string(), try_cast("VARCHAR"),),  # alias for VARCHAR
     # STRINGS
-    "LEN": (None, _iterate_single_parameter(get_len),),  # LENGTH(str) -> int
-    "LENGTH": (None, _iterate_single_parameter(get_len),),  # LENGTH(str) -> int
+    "LEN": (pyarrow.int64(), get_len,),  # LENGTH(str) -> int
+    "LENGTH": (pyarrow.int64(), get_len,),  # LENGTH(str) -> int
     "UPPER": (None, compute.utf8_upper,),  # UPPER(str) -> str
     "LOWER": (None, compute.utf8_lower,),  # LOWER(str) -> str
     "TRIM": (None, compute.utf8_trim_whitespace,),  # TRIM(str) -> str
-    "LEFT": (None, string_functions.string_slicer_left,),
-    "RIGHT": (None, string_functions.string_slicer_right,),
+    "LEFT": (None, _numpy_parameters(string_functions.string_slicer_left),),
+    "RIGHT": (None, _numpy_parameters(string_functions.string_slicer_right),),
     # HASHING & ENCODING
-    "HASH": (None, _iterate_single_parameter(lambda x: format(CityHash64(str(x)), "X")),),
-    "MD5": (None, _iterate_single_parameter(get_md5),),
+    "HASH": (pyarrow.string(), get_hash,),
+    "MD5": (pyarrow.string(), get_md5,),
     "RANDOM": (None, _iterate_no_parameters(get_random),),  # return a random number 0-0.999
     # OTHER
-    "GET": (None, _iterate_double_parameter(_get),),  # GET(LIST, index) => LIST[index] or GET(STRUCT, accessor) => STRUCT[accessor]
-    "LIST_CONTAINS": (None, _iterate_double_parameter(other_functions.list_contains),),
-    "LIST_CONTAINS_ANY": (None, _iterate_double_parameter(other_functions.list_contains_any),),
-    "LIST_CONTAINS_ALL": (None, _iterate_double_parameter(other_functions.list_contains_all),),
-    "SEARCH": (None, other_functions.search,),
+    "GET": (None, other_functions.get,),  # GET(LIST, index) => LIST[index] or GET(STRUCT, accessor) => STRUCT[accessor]
+    "LIST_CONTAINS": (pyarrow.bool_(), other_functions.list_contains,),
+    "LIST_CONTAINS_ANY": (pyarrow.bool_(), other_functions.list_contains_any,),
+    "LIST_CONTAINS_ALL": (pyarrow.bool_(), other_functions.list_contains_all,),
+    "SEARCH": (None, _numpy_parameters(other_functions.search),),
     "COALESCE": (None, compute.coalesce,),
 
     # NUMERIC
@@ -229,7 +254,7 @@ FUNCTIONS = {
     "TRUNCATE": (None, compute.trunc,),
     "PI": (None, _repeat_no_parameters(number_functions.pi)),
     # DATES & TIMES
-    "DATE_TRUNC": (None, _iterate_double_parameter_field_second(date_trunc),),
+    "DATE_TRUNC": (pyarrow.timestamp("us"), date_functions.date_trunc,),
     "TIME_BUCKET": (None, compute.floor_temporal),
     "DATEDIFF": (pyarrow.float64(), date_functions.date_diff,),
     "DATEPART": (None, date_functions.date_part,),
@@ -240,7 +265,7 @@ FUNCTIONS = {
     "TODAY": (None, _repeat_no_parameters(datetime.datetime.utcnow().date),),
     "TIME": (None, _repeat_no_parameters(date_functions.get_time),),
     "YESTERDAY": (None, _repeat_no_parameters(date_functions.get_yesterday),),
-    "DATE": (None, _iterate_single_parameter(date_functions.get_date),),
+    "DATE": (pyarrow.timestamp("us"), date_functions.get_date,),
     "YEAR": (None, compute.year,),
     "MONTH": (None, compute.month,),
     "DAY": (None, compute.day,),
@@ -16,8 +16,13 @@ import pyarrow
 from pyarrow import compute
 
 from opteryx.exceptions import SqlError
+from opteryx.third_party.date_trunc import date_trunc as truncate_value
+from opteryx.utils.arrow import as_array, map_distinct
 from opteryx.utils.dates import parse_iso
 
+# the units floor_temporal truncates to, which date_trunc supports
+TRUNCATE_UNITS = {"second", "minute", "hour", "day", "week", "month", "quarter", "year"}
+
 
 def get_time():
     """
@@ -33,7 +38,7 @@ def get_yesterday():
     return datetime.datetime.utcnow().date() - datetime.timedelta(days=1)
 
 
-def get_date(timestamp):
+def _get_date(timestamp):
     """
     Convert input to a datetime object and extract the Date part
     """
@@ -53,6 +58,41 @@ def get_date(timestamp):
     return None
 
 
+def get_date(timestamps):
+    """
+    The Date part of timestamps, as a timestamp at midnight
+    """
+    timestamps = as_array(timestamps)
+    if pyarrow.types.is_timestamp(timestamps.type):
+        return compute.floor_temporal(timestamps, unit="day").cast(
+            pyarrow.timestamp("us")
+        )
+    if pyarrow.types.is_date(timestamps.type):
+        return timestamps.cast(pyarrow.timestamp("us"))
+    return map_distinct(_get_date, timestamps, pyarrow.timestamp("us"))
+
+
+def date_trunc(truncate_to, timestamps):
+    """
+    Truncate timestamps to the start of the second, minute, hour, day, week (Monday),
+    month, quarter or year
+    """
+    timestamps = as_array(timestamps)
+    if str(truncate_to).lower() in TRUNCATE_UNITS and (
+        pyarrow.types.is_timestamp(timestamps.type)
+        or pyarrow.types.is_date(timestamps.type)
+    ):
+        truncated = compute.floor_temporal(
+            timestamps, unit=truncate_to.lower(), week_starts_monday=True
+        )
+        return truncated.cast(pyarrow.timestamp("us"))
+    return map_distinct(
+        lambda value: None if value is None else truncate_value(truncate_to, value),
+        timestamps,
+        pyarrow.timestamp("us"),
+    )
+
+
 def date_part(part, arr):
     """
     Also the EXTRACT function - we extract a given part from an array of dates
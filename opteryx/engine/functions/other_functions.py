@@ -10,36 +10,175 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
+"""
+Functions on lists and structs, these work on the Arrow arrays, values which can't be
+handled by the Arrow kernels (e.g. comparing values of different types) are handled
+one row at a time.
+"""
 import numpy
+import pyarrow
 
 from pyarrow import compute
 
+from opteryx.utils.arrow import as_array
+
+
+def _is_list(array):
+    return (
+        pyarrow.types.is_list(array.type)
+        or pyarrow.types.is_large_list(array.type)
+        or pyarrow.types.is_fixed_size_list(array.type)
+    )
+
+
+def _per_row(function, array, *args):
+    """the row at a time implementation, for values the kernels can't handle"""
+    values = array.to_numpy(zero_copy_only=False)
+    return pyarrow.array([function(value, *args) for value in values])
+
+
+def _get(value, item):
+    try:
+        if isinstance(value, dict):
+            return value.get(item)
+        return value[int(item)]
+    except (KeyError, IndexError, TypeError):
+        return None
+
+
+def get(array, item):
+    """
+    GET(LIST, index) => LIST[index], GET(STRUCT, accessor) => STRUCT[accessor] and
+    GET(VARCHAR, index) => the character at index, null if there isn't a value
+    """
+    array = as_array(array)
+    if pyarrow.types.is_struct(array.type):
+        if any(field.name == item for field in array.type):
+            return compute.struct_field(array, [item])
+        return pyarrow.nulls(len(array))
+    if isinstance(item, (int, float, numpy.number)) and int(item) >= 0:
+        index = int(item)
+        if _is_list(array):
+            # a list of one item, null if the list is too short
+            sliced = compute.list_slice(
+                array, index, index + 1, return_fixed_size_list=True
+            )
+            return compute.list_element(sliced, 0)
+        if pyarrow.types.is_string(array.type):
+            sliced = compute.utf8_slice_codeunits(array, index, index + 1)
+            return compute.if_else(
+                compute.equal(sliced, ""), pyarrow.scalar(None, array.type), sliced
+            )
+    return _per_row(_get, array, item)
+
+
+def _comparable(array, items):
+    """
+    the kernels cast the items to the type of the values in the lists, which would
+    match values the items aren't equal to (e.g. 2 and '2'), so the kernels are only
+    used when the items are the same kind of value as the values in the lists
+    """
+    if not _is_list(array):
+        return False
+    value_type = array.type.value_type
+    try:
+        items_type = pyarrow.array(list(items)).type
+    except (pyarrow.ArrowInvalid, pyarrow.ArrowTypeError, TypeError):
+        # e.g. items of different types
+        return False
+    if value_type == items_type:
+        return True
+    numeric = (pyarrow.types.is_integer, pyarrow.types.is_floating)
+    strings = (pyarrow.types.is_string, pyarrow.types.is_large_string)
+    return any(
+        any(check(value_type) for check in kind)
+        and any(check(items_type) for check in kind)
+        for kind in (numeric, strings)
+    )
+
+
+def _matching_rows(array, matches):
+    """the rows of a list array where any of the items match"""
+    parents = compute.list_parent_indices(array).to_numpy(zero_copy_only=False)
+    matches = compute.fill_null(matches, False).to_numpy(zero_copy_only=False)
+    found = numpy.zeros(len(array), dtype=bool)
+    found[parents[matches]] = True
+    return found
+
+
+def _list_contains(array, item):
+    if array is None:
+        return False
+    return item in set(array)
+
 
 def list_contains(array, item):
     """
     does array contain item
     """
+    array = as_array(array)
+    if _comparable(array, [item]):
+        try:
+            matches = compute.equal(compute.list_flatten(array), item)
+            return pyarrow.array(_matching_rows(array, matches))
+        except (pyarrow.ArrowInvalid, pyarrow.ArrowNotImplementedError, TypeError):
+            pass
+    return _per_row(_list_contains, array, item)
+
+
+def _list_contains_any(array, items):
     if array is None:
         return False
-    return item in set(array)
+    return set(array).intersection(items) != set()
 
 
 def list_contains_any(array, items):
     """
     does array contain any of the items in items
     """
+    array = as_array(array)
+    if _comparable(array, items):
+        try:
+            matches = compute.is_in(
+                compute.list_flatten(array), value_set=pyarrow.array(list(items))
+            )
+            return pyarrow.array(_matching_rows(array, matches))
+        except (pyarrow.ArrowInvalid, pyarrow.ArrowNotImplementedError, TypeError):
+            pass
+    return _per_row(_list_contains_any, array, items)
+
+
+def _list_contains_all(array, items):
     if array is None:
         return False
-    return set(array).intersection(items) != set()
+    return set(array).issuperset(items)
 
 
 def list_contains_all(array, items):
     """
     does array contain all of the items in items
     """
-    if array is None:
-        return False
-    return set(array).issuperset(items)
+    array = as_array(array)
+    if _comparable(array, items):
+        try:
+            value_set = compute.unique(pyarrow.array(list(items)))
+            positions = compute.index_in(
+                compute.list_flatten(array), value_set=value_set
+            )
+            parents = compute.list_parent_indices(array).to_numpy(zero_copy_only=False)
+            positions = compute.fill_null(positions, -1).to_numpy(zero_copy_only=False)
+            found = positions >= 0
+            # count the distinct items found in each list
+            pairs = numpy.unique(parents[found] * len(value_set) + positions[found])
+            counts = numpy.bincount(
+                pairs // max(len(value_set), 1), minlength=len(array)
+            )
+            contains = counts == len(value_set)
+            contains &= compute.is_valid(array).to_numpy(zero_copy_only=False)
+            return pyarrow.array(contains)
+        except (pyarrow.ArrowInvalid, pyarrow.ArrowNotImplementedError, TypeError):
+            pass
+    return _per_row(_list_contains_all, array, items)
 
 
 def search(array, item):
@@ -12,9 +12,10 @@
 """
 Implement conditions which are essentially unary statements, usually IS statements.
 
-This are executed as functions on arrays rather than functions on elements in arrays.
+This are executed as functions on arrays rather than functions on elements in arrays,
+they return a boolean mask of the matching rows, these conditions are never null.
 """
-import numpy
+import pyarrow
 
 from pyarrow import compute
 
@@ -22,33 +23,37 @@ from opteryx.engine.attribute_types import TOKEN_TYPES
 from opteryx.exceptions import SqlError
 
 
+def _as_boolean(column):
+    if column.type != pyarrow.bool_():
+        return column.cast(pyarrow.bool_())
+    return column
+
+
 def _is_null(table, identifier):
     if len(identifier) == 2 and identifier[1] == TOKEN_TYPES.IDENTIFIER:
-        column = table.column(identifier[0]).to_numpy()
-        return numpy.nonzero(compute.is_null(column, nan_is_null=True))[0]
+        column = table.column(identifier[0])
+        return compute.is_null(column, nan_is_null=True)
     raise SqlError("`IS NULL` is not supported for literals or functions.")
 
 
 def _is_not_null(table, identifier):
     if len(identifier) == 2 and identifier[1] == TOKEN_TYPES.IDENTIFIER:
-        column = table.column(identifier[0]).to_numpy()
-        matches = compute.is_null(column, nan_is_null=True)
-        return numpy.nonzero(numpy.invert(matches))[0]
+        column = table.column(identifier[0])
+        return compute.invert(compute.is_null(column, nan_is_null=True))
     raise SqlError("`IS NOT NULL` is not supported for literals or functions.")
 
 
 def _is_true(table, identifier):
     if len(identifier) == 2 and identifier[1] == TOKEN_TYPES.IDENTIFIER:
-        column = table.column(identifier[0]).to_numpy()
-        return numpy.nonzero(column)[0]
+        column = _as_boolean(table.column(identifier[0]))
+        return compute.fill_null(column, False)
     raise SqlError("`IS TRUE` is not supported for literals or functions.")
 
 
 def _is_false(table, identifier):
     if len(identifier) == 2 and identifier[1] == TOKEN_TYPES.IDENTIFIER:
-        column = table.column(identifier[0]).to_numpy()
-        matches = numpy.invert(column)
-        return numpy.nonzero(matches)[0]
+        column = _as_boolean(table.column(identifier[0]))
+        return compute.fill_null(compute.invert(column), False)
     raise SqlError("`IS TRUE` is not supported for literals or functions.")
 
 
@@ -21,6 +21,7 @@ from .distinct_node import DistinctNode  # remove duplicate records
 from .evaluation_node import EvaluationNode  # aliases and evaluations
 from .explain_node import ExplainNode  # EXPLAIN queries
 from .function_dataset_node import FunctionDatasetNode  # Dataset Constructors
+from .heap_sort_node import HeapSortNode  # ORDER BY with a LIMIT
 from .inner_join_node import InnerJoinNode  # INNER JOIN
 from .internal_dataset_node import InternalDatasetNode  # Sample datasets
 from .limit_node import LimitNode  # select the first N records
@@ -15,84 +15,509 @@ Grouping Node
 
 This is a SQL Query Execution Plan Node.
 
-This performs aggregations, both of grouped and non-grouped data. 
+This performs aggregations, both of grouped and non-grouped data.
 
 This is a greedy operator - it consumes all the data before responding.
 
-This algorithm is a balance of performance, it is much slower than a groupby based on
-the pyarrow_ops library for datasets with a high number of duplicate values (e.g.
-grouping by a boolean column) - on a 10m record set, timings are 10:1 (removing raw
-read time - e.g. 30s:21s where 20s is the read time).
+The aggregation is performed in two phases:
 
-But, on high cardinality data (nearly unique columns), the performance is much faster,
-on a 10m record set, timings are 1:400 (50s:1220s where 20s is the read time).
+- each page is pre-aggregated into a partial table of states (e.g. a SUM and a COUNT
+  for an AVG), this is done by a pool of worker threads so pages are aggregated in
+  parallel.
+- the partial tables are partitioned by the hash of the group keys, so each group
+  is in exactly one partition, and the partitions are merged and finalized in
+  parallel.
+
+If the data is ordered by the group keys (the planner tells us), groups are
+finalized and emitted as soon as the next group starts, only the last group of each
+page is held in memory.
+
+COUNT(DISTINCT) collects the distinct values of each group as a state, the lists are
+concatenated and deduplicated when the partial states are merged, so the distinct
+values are spilled and partitioned the same as any other state.
+
+ROLLUP, CUBE and GROUPING SETS are aggregated at the finest grouping (all of the
+group keys), the coarser groupings are then derived by merging these states again
+by fewer keys, the data is only read and aggregated once.
+
+If the partial states grow beyond the memory budget (e.g. grouping by a nearly unique
+column), they are written, partitioned by the group keys, to spill files on local
+disk. Each of the partitions is then read back and finalized one at a time.
+
+The grouping is done by pyarrow, which releases the GIL, so the workers are able to
+use all of the available cores. When grouping by a single dictionary encoded column,
+the dictionary indices are used directly to index arrays of states, avoiding hashing.
 """
+import itertools
+
+from collections import deque
+from concurrent.futures import ThreadPoolExecutor
 from typing import Iterable, List
 
 import numpy as np
-import pyarrow.json
+import pyarrow
+from pyarrow import compute
 
+from opteryx import config
 from opteryx.engine.attribute_types import TOKEN_TYPES
 from opteryx.engine import QueryDirectives, QueryStatistics
 from opteryx.engine.planner.operations import BasePlanNode
 from opteryx.exceptions import SqlError
+from opteryx.utils.arrow import partition_table
 from opteryx.utils.columns import Columns
+from opteryx.utils.spill import SpillFiles
 
 COUNT_STAR: str = "COUNT(*)"
+LIST_MERGE: str = "list_merge"
+DISTINCT_MERGE: str = "distinct_merge"
+NO_GROUP: str = "__no_group"
 
-# these functions can be applied to each group
-INCREMENTAL_AGGREGATES = {
-    "MIN": min,
-    "MINIMUM": min,
-    "MAX": max,
-    "MAXIMUM": max,
-    "SUM": lambda x, y: x + y,
-}
-
+MAX_WORKER_THREADS = max(config.MAX_WORKER_THREADS, 1)
+# the number of pages we allow to be waiting to be aggregated
+MAX_PAGES_IN_FLIGHT = MAX_WORKER_THREADS * 2
+# the number of partial tables we collect before merging them
+COMPACTION_THRESHOLD = MAX_WORKER_THREADS * 8
+# below this number of groups, we don't partition the final merge
+PARTITION_THRESHOLD = 100000
+# when the states exceed this size, they're written to disk
+MAX_OPERATOR_MEMORY = config.MAX_OPERATOR_MEMORY
+# the number of partitions states are spilled to
+SPILL_PARTITIONS = 64
+# if the direct accumulators grow beyond this, we switch to hashing
+MAX_DIRECT_GROUPS = 65536
+# percentiles are selected by partitioning when the groups average this many values
+PARTITION_GROUP_SIZE = 100
+# small result tables are combined into pages of at least this many rows
+OUTPUT_PAGE_ROWS = 65536
 
-# these functions need the whole dataset
-WHOLE_AGGREGATES = {
-    "AVG": np.mean,
-    "AVERAGE": np.mean,
-    "MEDIAN": np.median,
-    "PRODUCT": np.prod,
-    "STDDEV_POP": np.std,
-    "VAR_POP": np.var,
-    "FIRST": lambda a: a[0],
-    "LAST": lambda a: a[-1],
-    "LIST": list,  # all of the values in a column as a list
+# the states which are built for each aggregate, the first of each pair is the
+# aggregation applied to each page, the second is how these partial states are merged
+AGGREGATORS = {
+    "COUNT": (("count", "sum"),),
+    "SUM": (("sum", "sum"),),
+    "MIN": (("min", "min"),),
+    "MINIMUM": (("min", "min"),),
+    "MAX": (("max", "max"),),
+    "MAXIMUM": (("max", "max"),),
+    "AVG": (("sum", "sum"), ("count", "sum")),
+    "AVERAGE": (("sum", "sum"), ("count", "sum")),
+    "PRODUCT": (("product", "product"),),
+    "FIRST": (("first", "first"),),
+    "LAST": (("last", "last"),),
+    # these functions need all of the values in the group
+    "MEDIAN": (("list", LIST_MERGE),),
+    "PERCENTILE_CONT": (("list", LIST_MERGE),),
+    "PERCENTILE_DISC": (("list", LIST_MERGE),),
+    "STDDEV_POP": (("list", LIST_MERGE),),
+    "VAR_POP": (("list", LIST_MERGE),),
+    "LIST": (("list", LIST_MERGE),),  # all of the values in a column as a list
     # range - difference between min and max
     # percent - each group has the relative portion calculated
-    # list - return a list of the items in the list
-    # quantile
     # approx_distinct
     # approx_quantile
 }
 
+# the states for aggregates of the DISTINCT values, e.g. COUNT(DISTINCT x)
+DISTINCT_AGGREGATORS = {
+    "COUNT": (("distinct", DISTINCT_MERGE),),
+}
+
+# aggregates which take the fraction as a second parameter, and if they interpolate
+PERCENTILES = {
+    "PERCENTILE_CONT": True,
+    "PERCENTILE_DISC": False,
+}
+
+
+def _mean(states):
+    total, count = states
+    total = compute.cast(total, pyarrow.float64())
+    return compute.if_else(compute.equal(count, 0), None, compute.divide(total, count))
+
+
+def _valid_values(lists):
+    """
+    the values in each group's list as a float buffer, with the group each value
+    belongs to, nulls and NaNs are removed
+    """
+    if isinstance(lists, pyarrow.ChunkedArray):
+        lists = lists.combine_chunks()
+    values = lists.flatten()
+    parents = compute.list_parent_indices(lists)
+    values = values.cast(pyarrow.float64())
+    valid = compute.and_(values.is_valid(), compute.invert(compute.is_nan(values)))
+    values = values.filter(valid).to_numpy(zero_copy_only=False)
+    parents = parents.filter(valid).to_numpy()
+    return values, parents, len(lists)
+
+
+def _variance(states):
+    """
+    the population variance of each group, calculated for all of the groups at
+    once - the deviations from each group's mean are summed by group
+    """
+    values, parents, groups = _valid_values(states[0])
+    counts = np.bincount(parents, minlength=groups)
+    totals = np.bincount(parents, weights=values, minlength=groups)
+    with np.errstate(invalid="ignore", divide="ignore"):
+        means = totals / counts
+        deviations = values - means[parents]
+        results = (
+            np.bincount(parents, weights=deviations * deviations, minlength=groups)
+            / counts
+        )
+    return pyarrow.array(results, mask=counts == 0)
+
+
+def _standard_deviation(states):
+    return compute.sqrt(_variance(states))
+
+
+def _percentile(fraction, interpolate):
+    """
+    select the value at a fraction through the sorted values of each group, the
+    positions in each group are found from the offset of the group in the values
+    ordered by group and then value - there's no loop over the groups.
+
+    Floating point values (which includes all of the values for PERCENTILE_CONT and
+    MEDIAN) are partitioned around all of the positions at once, rather than sorted,
+    when the groups are large enough for that to be quicker. Other values are sorted
+    by group and then value.
+
+    PERCENTILE_CONT interpolates between the values either side of the position,
+    PERCENTILE_DISC returns the first value at or after the position.
+    """
 
-def _incremental(x, y, function):
-    if function in INCREMENTAL_AGGREGATES:
-        return INCREMENTAL_AGGREGATES[function](x, y)
-    return np.concatenate(x, y)
+    def _inner(states):
+        lists = states[0]
+        if isinstance(lists, pyarrow.ChunkedArray):
+            lists = lists.combine_chunks()
+        values = lists.flatten()
+        parents = compute.list_parent_indices(lists)
 
+        # nulls and NaNs are ignored
+        valid = values.is_valid()
+        if pyarrow.types.is_floating(values.type):
+            valid = compute.and_(valid, compute.invert(compute.is_nan(values)))
+        values = values.filter(valid)
+        parents = parents.filter(valid)
 
-def _map(table, collect_columns):
-    # if we're aggregating on * we don't care about the data, just the number of
-    # records
-    if collect_columns == ["*"]:
-        for i in range(table.num_rows):
-            yield (("*", "*"),)
-        return
+        if interpolate:
+            if not (
+                pyarrow.types.is_integer(values.type)
+                or pyarrow.types.is_floating(values.type)
+            ):
+                raise SqlError(
+                    "`PERCENTILE_CONT` and `MEDIAN` can only be applied to numeric values."
+                )
+            values = values.cast(pyarrow.float64())
+        if len(values) == 0:
+            return pyarrow.nulls(len(lists), type=values.type)
+
+        counts = np.bincount(parents.to_numpy(), minlength=len(lists))
+        starts = np.concatenate(([0], np.cumsum(counts)[:-1]))
+        empty = counts == 0
+
+        if interpolate:
+            position = fraction * np.maximum(counts - 1, 0)
+            low = np.floor(position).astype(np.int64)
+            high = np.ceil(position).astype(np.int64)
+            weights = position - low
+        else:
+            low = high = np.maximum(np.ceil(fraction * counts).astype(np.int64) - 1, 0)
+        # empty groups point at the first value, their result is masked
+        low = np.where(empty, 0, starts + low)
+        high = np.where(empty, 0, starts + high)
+
+        if pyarrow.types.is_floating(values.type) and len(
+            values
+        ) >= PARTITION_GROUP_SIZE * (len(lists) - empty.sum()):
+            # complex numbers are ordered by their real and then imaginary parts, so
+            # this orders by group and then value
+            keys = np.empty(len(values), dtype=np.complex128)
+            keys.real = parents.to_numpy()
+            keys.imag = values.to_numpy(zero_copy_only=False)
+            ordered = np.partition(keys, np.union1d(low, high)).imag
+            lower, upper = ordered[low], ordered[high]
+        else:
+            order = compute.sort_indices(
+                pyarrow.table({"group": parents, "value": values}),
+                sort_keys=[("group", "ascending"), ("value", "ascending")],
+            ).to_numpy()
+            if not interpolate:
+                return values.take(pyarrow.array(order[low], mask=empty))
+            buffer = values.to_numpy(zero_copy_only=False)
+            lower, upper = buffer[order[low]], buffer[order[high]]
+
+        if not interpolate:
+            return pyarrow.array(lower, type=values.type, mask=empty)
+        return pyarrow.array(lower + (upper - lower) * weights, mask=empty)
+
+    return _inner
+
+
+def _count_lists(states):
+    lengths = compute.list_value_length(states[0])
+    return compute.fill_null(lengths, 0).cast(pyarrow.int64())
+
+
+# how to turn the merged states into the result of the aggregation, if the
+# function isn't here, the result is the first (and only) state
+FINALIZERS = {
+    "AVG": _mean,
+    "AVERAGE": _mean,
+    "MEDIAN": _percentile(0.5, True),
+    "STDDEV_POP": _standard_deviation,
+    "VAR_POP": _variance,
+    "COUNT DISTINCT": _count_lists,
+}
+
+
+def _decoded_type(data_type):
+    if pyarrow.types.is_dictionary(data_type):
+        return data_type.value_type
+    return data_type
+
+
+def _decode_dictionaries(table):
+    """
+    Each page can have a different dictionary, Arrow can't combine the groups from
+    tables with different dictionaries so the keys in the states are decoded.
+    """
+    for index, field in enumerate(table.schema):
+        if pyarrow.types.is_dictionary(field.type):
+            table = table.set_column(
+                index, field.name, table.column(index).cast(field.type.value_type)
+            )
+    return table
+
+
+def _merge_lists(states, row_lists):
+    """
+    pyarrow can't 'list' a list column, so we group the row numbers of the states
+    and concatenate the lists in those rows together
+    """
+    if isinstance(row_lists, pyarrow.ChunkedArray):
+        row_lists = row_lists.combine_chunks()
+    members = states.take(row_lists.flatten())
+    if isinstance(members, pyarrow.ChunkedArray):
+        members = members.combine_chunks()
+    member_lengths = compute.fill_null(compute.list_value_length(members), 0)
+    value_offsets = np.concatenate(([0], np.cumsum(member_lengths.to_numpy())))
+    group_offsets = row_lists.offsets.to_numpy()
+    offsets = pyarrow.array(value_offsets[group_offsets], type=pyarrow.int32())
+    return pyarrow.ListArray.from_arrays(offsets, members.flatten())
+
+
+def _merge_distinct(states, row_lists):
+    """
+    concatenate the lists of distinct values and remove the duplicates, this is done
+    by grouping the (group, value) pairs - groups with no values are null
+    """
+    merged = _merge_lists(states, row_lists)
+    pairs = pyarrow.Table.from_arrays(
+        [compute.list_parent_indices(merged), merged.flatten()],
+        names=["__parent", "__value"],
+    )
+    distinct = pairs.group_by(["__parent"], use_threads=False).aggregate(
+        [("__value", "distinct")]
+    )
+    positions = np.full(len(merged), -1, dtype=np.int64)
+    positions[distinct["__parent"].to_numpy()] = np.arange(distinct.num_rows)
+    return distinct["__value_distinct"].take(
+        pyarrow.array(positions, mask=positions < 0)
+    )
+
+
+# how states which are lists are merged
+LIST_MERGES = {
+    LIST_MERGE: _merge_lists,
+    DISTINCT_MERGE: _merge_distinct,
+}
 
-    if "*" in collect_columns:
-        collect_columns = [c for c in collect_columns if c != "*"]
-    arr = [c.to_numpy() for c in table.select(collect_columns)]
 
-    for row_index in range(len(arr[0])):
-        ret = []
-        for column_index, column_name in enumerate(collect_columns):
-            ret.append((column_name, arr[column_index][row_index]))
-        yield ret
+class DirectAccumulator:
+    """
+    A fast path for grouping by a single dictionary encoded key (e.g. a status or a
+    country), rather than hashing the key values, the dictionary index of each row
+    is used as a code and the states are accumulated into arrays indexed by that
+    code.
+
+    The pages are coded and pre-aggregated by the workers (partial), the per-page
+    results are then folded into the global accumulators (add). The accumulators
+    are returned as a table of states, the same as the hash path produces.
+    """
+
+    SUPPORTED = {"count_all", "count", "sum", "min", "max"}
+
+    def __init__(self, group, schema, partial_aggregations):
+        self.group = group
+        self.key_type = schema.field(group).type
+        self.aggregations = partial_aggregations
+        self.types = {
+            state: schema.field(column).type
+            for column, _, state in partial_aggregations
+            if column
+        }
+        self.keys: List = []
+        self.lookup: dict = {}
+        self.states: dict = {}
+
+    @staticmethod
+    def eligible(page, groups, partial_aggregations):
+        """is this grouping able to use the direct accumulators"""
+        if len(groups) != 1:
+            return False
+        for column, function, _ in partial_aggregations:
+            if function not in DirectAccumulator.SUPPORTED:
+                return False
+            if function in ("sum", "min", "max"):
+                column_type = page.schema.field(column).type
+                if not (
+                    pyarrow.types.is_floating(column_type)
+                    or pyarrow.types.is_integer(column_type)
+                ) or pyarrow.types.is_uint64(column_type):
+                    return False
+
+        # the dictionary indices are the codes, so we don't need to hash the keys,
+        # for other types, encoding the keys costs more than pyarrow's hash
+        # aggregation so they don't use this path
+        key_type = page.schema.field(groups[0]).type
+        return pyarrow.types.is_dictionary(key_type)
+
+    def _initial(self, function, state, size):
+        """the starting values for an accumulator"""
+        if function in ("count_all", "count"):
+            return np.zeros(size, dtype=np.int64)
+        if pyarrow.types.is_floating(self.types[state]):
+            if function == "sum":
+                return np.zeros(size, dtype=np.float64)
+            # fmin and fmax ignore NaNs
+            return np.full(size, np.nan, dtype=np.float64)
+        if function == "sum":
+            return np.zeros(size, dtype=np.int64)
+        if function == "min":
+            return np.full(size, np.iinfo(np.int64).max, dtype=np.int64)
+        return np.full(size, np.iinfo(np.int64).min, dtype=np.int64)
+
+    def partial(self, page):
+        """code the keys of a page and accumulate the page's states"""
+        key = page.column(self.group)
+        if isinstance(key, pyarrow.ChunkedArray):
+            key = key.combine_chunks()
+        indices, dictionary = key.indices, key.dictionary
+
+        # nulls are given the code after the last dictionary entry
+        size = len(dictionary) + 1
+        codes = indices
+        if codes.null_count > 0:
+            codes = compute.fill_null(codes.cast(pyarrow.int64()), size - 1)
+        codes = codes.to_numpy(zero_copy_only=False)
+        rows = np.bincount(codes, minlength=size)
+
+        states = {}
+        for column, function, state in self.aggregations:
+            if function == "count_all":
+                states[state] = (rows, None)
+                continue
+
+            values = page.column(column)
+            if isinstance(values, pyarrow.ChunkedArray):
+                values = values.combine_chunks()
+            valid_codes = codes
+            seen = rows
+            if values.null_count > 0:
+                valid = values.is_valid().to_numpy(zero_copy_only=False)
+                valid_codes = codes[valid]
+                seen = np.bincount(valid_codes, minlength=size)
+                values = values.filter(valid)
+            if function == "count":
+                states[state] = (seen, None)
+                continue
+
+            accumulator = self._initial(function, state, size)
+            values = values.cast(pyarrow.from_numpy_dtype(accumulator.dtype))
+            values = values.to_numpy(zero_copy_only=False)
+            if function == "sum" and accumulator.dtype == np.float64:
+                accumulator = np.bincount(valid_codes, weights=values, minlength=size)
+            elif function == "sum":
+                np.add.at(accumulator, valid_codes, values)
+            elif function == "min":
+                np.fmin.at(accumulator, valid_codes, values)
+            else:
+                np.fmax.at(accumulator, valid_codes, values)
+            states[state] = (accumulator, seen)
+
+        present = rows > 0
+        return dictionary.to_pylist() + [None], present, states
+
+    def add(self, partial):
+        """fold the states from a page into the global accumulators"""
+        keys, present, states = partial
+
+        slots = np.flatnonzero(present)
+        codes = np.empty(len(slots), dtype=np.int64)
+        for index, slot in enumerate(slots):
+            key = keys[slot]
+            code = self.lookup.get(key)
+            if code is None:
+                code = len(self.keys)
+                self.lookup[key] = code
+                self.keys.append(key)
+            codes[index] = code
+
+        size = len(self.keys)
+        for _, function, state in self.aggregations:
+            if state not in self.states:
+                self.states[state] = (
+                    self._initial(function, state, 0),
+                    np.zeros(0, dtype=np.int64),
+                )
+            accumulator, seen = self.states[state]
+            if len(accumulator) < size:
+                grow = size - len(accumulator)
+                accumulator = np.concatenate(
+                    (accumulator, self._initial(function, state, grow))
+                )
+                seen = np.concatenate((seen, np.zeros(grow, dtype=np.int64)))
+
+            values, values_seen = states[state]
+            # a dictionary can have the same value more than once, so the codes can
+            # repeat, the unbuffered .at methods apply every one of them
+            if function in ("count_all", "count", "sum"):
+                np.add.at(accumulator, codes, values[slots])
+            elif function == "min":
+                np.fmin.at(accumulator, codes, values[slots])
+            else:
+                np.fmax.at(accumulator, codes, values[slots])
+            if values_seen is not None:
+                np.add.at(seen, codes, values_seen[slots])
+            self.states[state] = (accumulator, seen)
+
+    @property
+    def groups(self):
+        return len(self.keys)
+
+    def to_table(self):
+        """convert the accumulators to a table of states"""
+        # the keys are decoded, pages have their own dictionaries and the hashed
+        # states can't be combined with states encoded with another dictionary
+        keys = pyarrow.array(self.keys, type=_decoded_type(self.key_type))
+
+        arrays = [keys]
+        names = [self.group]
+        for _, function, state in self.aggregations:
+            accumulator, seen = self.states[state]
+            if function in ("count_all", "count"):
+                array = pyarrow.array(accumulator, type=pyarrow.int64())
+            else:
+                array = pyarrow.array(accumulator, mask=seen == 0)
+                if function != "sum":
+                    # min and max are the same type as the values
+                    array = array.cast(self.types[state])
+            arrays.append(array)
+            names.append(state)
+        return pyarrow.Table.from_arrays(arrays, names=names)
 
 
 class AggregateNode(BasePlanNode):
@@ -108,6 +533,27 @@ class AggregateNode(BasePlanNode):
         aggregates = config.get("aggregates", [])
         for attribute in aggregates:
             if "aggregate" in attribute:
+                if attribute["aggregate"] not in AGGREGATORS:
+                    raise SqlError(
+                        f"Unknown aggregate function `{attribute['aggregate']}`."
+                    )
+                if (
+                    attribute.get("distinct")
+                    and attribute["aggregate"] not in DISTINCT_AGGREGATORS
+                ):
+                    raise SqlError(
+                        f"`DISTINCT` cannot be used with `{attribute['aggregate']}`."
+                    )
+                if attribute["aggregate"] in PERCENTILES:
+                    arguments = attribute["args"]
+                    if (
+                        len(arguments) != 2
+                        or arguments[1][1] != TOKEN_TYPES.NUMERIC
+                        or not 0 <= arguments[1][0] <= 1
+                    ):
+                        raise SqlError(
+                            f"`{attribute['aggregate']}` requires a column and a fraction between 0 and 1, e.g. `{attribute['aggregate']}(column, 0.9)`."
+                        )
                 self._aggregates.append(attribute)
                 argument = attribute["args"][0]
                 column = argument[0]
@@ -139,8 +585,29 @@ class AggregateNode(BasePlanNode):
         self._mapped_project: List = []
         self._mapped_groups: List = []
 
+        # these are populated when we see the first page
+        self._partial_aggregations: List = []
+        self._merge_aggregations: List = []
+        self._outputs: List = []
+
+        # ROLLUP, CUBE and GROUPING SETS are a list of groupings
+        self._grouping_sets = config.get("grouping_sets")
+        self._mapped_grouping_sets: List = []
+        self._group_types: dict = {}
+
+        # the planner tells us if the data is ordered by the group keys
+        self._ordered = (
+            config.get("ordered", False)
+            and len(self._groups) > 0
+            and not self._grouping_sets
+        )
+
     @property
     def config(self):  # pragma: no cover
+        if self._ordered:
+            return f"{self._aggregates} (ordered)"
+        if self._grouping_sets:
+            return f"{self._aggregates} (grouping sets {self._grouping_sets})"
         return str(self._aggregates)
 
     def greedy(self):  # pragma: no cover
@@ -160,6 +627,8 @@ class AggregateNode(BasePlanNode):
             return False
         if aggregates[0]["aggregate"] != "COUNT":
             return False
+        if aggregates[0].get("distinct"):
+            return False
         if aggregates[0]["args"] != [("Wildcard", TOKEN_TYPES.WILDCARD)]:
             return False
         return True
@@ -168,7 +637,9 @@ class AggregateNode(BasePlanNode):
         count = 0
         for page in data_pages.execute():
             count += page.num_rows
-        table = pyarrow.Table.from_pylist([{COUNT_STAR: count}])
+        table = pyarrow.Table.from_arrays(
+            [pyarrow.array([count], type=pyarrow.int64())], names=[COUNT_STAR]
+        )
         table = Columns.create_table_metadata(
             table=table,
             expected_rows=1,
@@ -177,6 +648,293 @@ class AggregateNode(BasePlanNode):
         )
         yield table
 
+    def _aggregate_from_metadata(self, data_pages):
+        """
+        Ungrouped COUNT(*), COUNT, MIN and MAX aggregates can be answered by some
+        readers from the file metadata without reading the data, we only ask if
+        we're reading directly from the reader - e.g. there's no WHERE clause.
+        """
+        if self._groups or not hasattr(data_pages, "aggregate_from_metadata"):
+            return None
+        if any(aggregrator.get("distinct") for aggregrator in self._aggregates):
+            return None
+
+        requests = []
+        names = []
+        for aggregrator in self._aggregates:
+            attribute = aggregrator["args"][0][0]
+            function = aggregrator["aggregate"]
+            if attribute == "Wildcard":
+                requests.append((function, None))
+                names.append(COUNT_STAR)
+            else:
+                requests.append((function, attribute))
+                names.append(f"{function}({attribute})")
+
+        results = data_pages.aggregate_from_metadata(requests)
+        if results is None:
+            return None
+
+        # deduplicate, e.g. MAX(id), MAX(id)
+        columns = dict(zip(names, results))
+        table = pyarrow.Table.from_arrays(
+            list(columns.values()), names=list(columns.keys())
+        )
+        return Columns.create_table_metadata(
+            table=table,
+            expected_rows=1,
+            name="groupby",
+            table_aliases=[],
+        )
+
+    def _map_columns(self, columns, page):
+        """
+        Work out the physical columns we're grouping and aggregating and the states
+        we need to collect to be able to perform the aggregations.
+        """
+        for key in self._project:
+            if key != "*":
+                if isinstance(key, int):
+                    key = self._positions[key - 1]
+                column = columns.get_column_from_alias(key, only_one=True)
+                if column not in self._mapped_project:
+                    self._mapped_project.append(column)
+            else:
+                self._mapped_project.append("*")
+
+        for group in self._groups:
+            # if we have a number, use it as an column offset
+            if isinstance(group, int):
+                group = self._positions[group - 1]
+            self._mapped_groups.append(
+                columns.get_column_from_alias(group, only_one=True)
+            )
+
+        for group in self._mapped_groups:
+            if pyarrow.types.is_nested(page.schema.field(group).type):
+                raise SqlError(
+                    "GROUP BY contains one or more columns which is a list or struct, cannot GROUP BY lists or structs."
+                )
+            self._group_types[group] = _decoded_type(page.schema.field(group).type)
+
+        if self._grouping_sets:
+            mapped = dict(zip(self._groups, self._mapped_groups))
+            for grouping in self._grouping_sets:
+                self._mapped_grouping_sets.append([mapped[g] for g in grouping])
+
+        states: dict = {}
+        for aggregrator in self._aggregates:
+            attribute = aggregrator["args"][0][0]
+            function = aggregrator["aggregate"]
+            column_name = f"{function}({attribute})"
+            if attribute == "Wildcard":
+                if function != "COUNT":
+                    raise SqlError(f"`{function}` cannot be applied to `*`.")
+                column_name = COUNT_STAR
+                mapped_attribute = []
+                aggregations = (("count_all", "sum"),)
+            elif aggregrator.get("distinct"):
+                column_name = f"{function}(DISTINCT {attribute})"
+                mapped_attribute = columns.get_column_from_alias(
+                    attribute, only_one=True
+                )
+                aggregations = DISTINCT_AGGREGATORS[function]
+                function = f"{function} DISTINCT"
+            else:
+                mapped_attribute = columns.get_column_from_alias(
+                    attribute, only_one=True
+                )
+                aggregations = AGGREGATORS[function]
+
+            finalizer = FINALIZERS.get(function)
+            if function in PERCENTILES:
+                fraction = aggregrator["args"][1][0]
+                column_name = f"{function}({attribute},{fraction})"
+                finalizer = _percentile(fraction, PERCENTILES[function])
+
+            if column_name in (name for name, _, _, _ in self._outputs):
+                continue
+
+            state_names = []
+            for partial, merge in aggregations:
+                key = (str(mapped_attribute), partial)
+                if key not in states:
+                    state = f"__state_{len(states)}"
+                    states[key] = state
+                    self._partial_aggregations.append(
+                        (mapped_attribute, partial, state)
+                    )
+                    self._merge_aggregations.append((state, merge))
+                state_names.append(states[key])
+            self._outputs.append((column_name, function, state_names, finalizer))
+
+    def _group_keys(self, table, keys=None):
+        """
+        Not all of the aggregations have an ungrouped implementation (e.g. list) so
+        when we're not grouping, everything is put in the same group.
+        """
+        if keys is None:
+            keys = self._mapped_groups
+        if keys:
+            return table, keys
+        if NO_GROUP not in table.column_names:
+            table = table.append_column(
+                NO_GROUP, pyarrow.nulls(table.num_rows, type=pyarrow.int8())
+            )
+        return table, [NO_GROUP]
+
+    def _partial(self, page):
+        """pre-aggregate a page into a table of states"""
+        page, keys = self._group_keys(page)
+        aggregated = page.group_by(keys, use_threads=False).aggregate(
+            [(column, function) for column, function, _ in self._partial_aggregations]
+        )
+        names = [
+            f"{column}_{function}" if column else function
+            for column, function, _ in self._partial_aggregations
+        ]
+        states = [state for _, _, state in self._partial_aggregations]
+        aggregated = aggregated.select(keys + names).rename_columns(keys + states)
+        return _decode_dictionaries(aggregated)
+
+    def _merge(self, partials, keys=None):
+        """combine partial tables so each group appears once"""
+        table, keys = self._group_keys(pyarrow.concat_tables(partials), keys)
+        aggregations = [
+            (state, merge)
+            for state, merge in self._merge_aggregations
+            if merge not in LIST_MERGES
+        ]
+        lists = [
+            (state, merge)
+            for state, merge in self._merge_aggregations
+            if merge in LIST_MERGES
+        ]
+        if lists:
+            table = table.append_column(
+                "__row", pyarrow.array(np.arange(table.num_rows, dtype=np.int64))
+            )
+            aggregations.append(("__row", "list"))
+
+        merged = table.group_by(keys, use_threads=False).aggregate(aggregations)
+        result = merged.select(
+            keys + [f"{state}_{merge}" for state, merge in aggregations]
+        ).rename_columns(keys + [state for state, _ in aggregations])
+
+        if lists:
+            row_lists = result["__row"]
+            result = result.drop(["__row"])
+            for state, merge in lists:
+                result = result.append_column(
+                    state, LIST_MERGES[merge](table[state], row_lists)
+                )
+        # keep the columns in the same order as the partials
+        return result.select(keys + [state for state, _ in self._merge_aggregations])
+
+    def _finalize(self, states, columns):
+        """turn the merged states into the results of the aggregations"""
+        arrays = []
+        names = []
+        for column_name, _, state_names, finalizer in self._outputs:
+            values = [states[state] for state in state_names]
+            arrays.append(finalizer(values) if finalizer else values[0])
+            names.append(column_name)
+        for group in self._mapped_groups:
+            if group in states.column_names:
+                arrays.append(states[group])
+            else:
+                # the group isn't part of this grouping set
+                arrays.append(
+                    pyarrow.nulls(states.num_rows, type=self._group_types[group])
+                )
+            names.append(columns.get_preferred_name(group))
+        return pyarrow.Table.from_arrays(arrays, names=names)
+
+    def _merge_and_finalize(self, partials, columns):
+        if self._grouping_sets:
+            # the coarser groupings need all of the groups, so don't finalize yet
+            return self._merge(partials)
+        return self._finalize(self._merge(partials), columns)
+
+    def _finalize_grouping_sets(self, merged, columns):
+        """
+        derive each of the groupings from the states of the finest grouping, by
+        merging the states again using only the keys in the grouping
+        """
+        merged = [table for table in merged if table.num_rows > 0]
+        if not merged:
+            return []
+        results = []
+        for grouping in self._mapped_grouping_sets:
+            if set(grouping) == set(self._mapped_groups):
+                results.extend(self._finalize(table, columns) for table in merged)
+            else:
+                results.append(self._finalize(self._merge(merged, grouping), columns))
+        return results
+
+    def _finalize_spilled_grouping_sets(self, spill, columns):
+        """
+        derive the groupings from the spilled states of the finest grouping a
+        partition at a time, the states for each of the coarser groupings are merged
+        and spilled again, partitioned by the grouping's own keys, so we never hold
+        more than one partition of states
+        """
+        coarser = [
+            grouping
+            for grouping in self._mapped_grouping_sets
+            if set(grouping) != set(self._mapped_groups)
+        ]
+        finest = len(coarser) < len(self._mapped_grouping_sets)
+        respills = [SpillFiles(partitions=spill.partitions) for _ in coarser]
+        try:
+            for partition in range(spill.partitions):
+                table = spill.read(partition)
+                if table is None:
+                    continue
+                merged = self._merge([table])
+                if finest:
+                    yield self._finalize(merged, columns)
+                for grouping, respill in zip(coarser, respills):
+                    states = self._merge([merged], grouping)
+                    for index, partitioned in enumerate(
+                        partition_table(states, grouping, respill.partitions)
+                    ):
+                        respill.write(index, partitioned)
+
+            for grouping, respill in zip(coarser, respills):
+                self._statistics.bytes_spilled += respill.bytes_written
+                for partition in range(respill.partitions):
+                    table = respill.read(partition)
+                    if table is not None:
+                        yield self._finalize(self._merge([table], grouping), columns)
+        finally:
+            for respill in respills:
+                respill.close()
+
+    def _is_single_count(self):
+        return len(self._outputs) == 1 and self._outputs[0][1] in (
+            "COUNT",
+            "COUNT DISTINCT",
+        )
+
+    def _empty_count(self, page, columns):
+        """count should return 0 rather than nothing"""
+        arrays = [pyarrow.array([0], type=pyarrow.int64())]
+        names = [self._outputs[0][0]]
+        for group in self._mapped_groups:
+            arrays.append(pyarrow.nulls(1, type=page.schema.field(group).type))
+            names.append(columns.get_preferred_name(group))
+        return pyarrow.Table.from_arrays(arrays, names=names)
+
+    def _spill(self, partials, spill):
+        """write the partial states to disk, partitioned by the group keys"""
+        combined = pyarrow.concat_tables(partials)
+        for partition, table in enumerate(
+            partition_table(combined, self._mapped_groups, spill.partitions)
+        ):
+            spill.write(partition, table)
+        self._statistics.spills += 1
+
     def execute(self) -> Iterable:
 
         if len(self._producers) != 1:
@@ -186,145 +944,234 @@ class AggregateNode(BasePlanNode):
         if isinstance(data_pages, pyarrow.Table):
             data_pages = (data_pages,)
 
+        table = self._aggregate_from_metadata(data_pages)
+        if table is not None:
+            yield table
+            return
+
         if self._is_count_star(self._aggregates, self._groups):
             yield from self._count_star(data_pages)
             return
 
-        from collections import defaultdict
+        if self._ordered:
+            yield from self._execute_ordered(data_pages)
+            return
 
-        collector: dict = defaultdict(dict)
         columns = None
+        first_page = None
+        partials: List = []
+        pending: deque = deque()
+        spill = None
+        direct = None
 
-        for page in data_pages.execute():
+        with ThreadPoolExecutor(max_workers=MAX_WORKER_THREADS) as pool:
+
+            def _collect(future):
+                nonlocal partials, spill, direct
+                partial = future.result()
+                if isinstance(partial, tuple):
+                    # the page was pre-aggregated by the direct accumulators
+                    if direct is None:
+                        # we've switched to hashing, convert to a table of states
+                        accumulator = DirectAccumulator(
+                            self._mapped_groups[0],
+                            first_page.schema,
+                            self._partial_aggregations,
+                        )
+                        accumulator.add(partial)
+                        partial = accumulator.to_table()
+                    else:
+                        direct.add(partial)
+                        if direct.groups <= MAX_DIRECT_GROUPS:
+                            return
+                        # the key isn't as low-cardinality as we estimated
+                        partial = direct.to_table()
+                        direct = None
+                partials.append(partial)
+                # keep the number of partial tables under control
+                if len(partials) >= COMPACTION_THRESHOLD:
+                    partials = [self._merge(partials)]
+                # if we're over the memory budget, write the states to disk, we
+                # can only do this when we're grouping
+                if (
+                    self._mapped_groups
+                    and sum(p.nbytes for p in partials) > MAX_OPERATOR_MEMORY
+                ):
+                    if spill is None:
+                        spill = SpillFiles(partitions=SPILL_PARTITIONS)
+                    self._spill(partials, spill)
+                    partials = []
+
+            # phase one - pre-aggregate the pages in parallel
+            for page in data_pages.execute():
+
+                if columns is None:
+                    columns = Columns(page)
+                    first_page = page
+                    self._map_columns(columns, page)
+                    if DirectAccumulator.eligible(
+                        page, self._mapped_groups, self._partial_aggregations
+                    ):
+                        direct = DirectAccumulator(
+                            self._mapped_groups[0],
+                            page.schema,
+                            self._partial_aggregations,
+                        )
+
+                if page.num_rows == 0:
+                    continue
+
+                if direct is not None:
+                    pending.append(pool.submit(direct.partial, page))
+                else:
+                    pending.append(pool.submit(self._partial, page))
+                while len(pending) > MAX_PAGES_IN_FLIGHT:
+                    _collect(pending.popleft())
+
+            while pending:
+                _collect(pending.popleft())
+
+            if direct is not None and direct.groups > 0:
+                partials.append(direct.to_table())
 
             if columns is None:
-                columns = Columns(page)
-
-                for key in self._project:
-                    if key != "*":
-                        if isinstance(key, int):
-                            key = self._positions[key - 1]
-                        column = columns.get_column_from_alias(key, only_one=True)
-                        if column not in self._mapped_project:
-                            self._mapped_project.append(column)
+                return
+
+            if spill is not None:
+                # phase two (spilled) - each partition is read back, merged and
+                # finalized, one partition at a time
+                with spill:
+                    if partials:
+                        self._spill(partials, spill)
+                        partials = []
+                    self._statistics.bytes_spilled += spill.bytes_written
+
+                    def _read_spilled_partitions():
+                        for partition in range(spill.partitions):
+                            table = spill.read(partition)
+                            if table is not None:
+                                yield self._merge_and_finalize([table], columns)
+
+                    if self._grouping_sets:
+                        results = self._finalize_spilled_grouping_sets(spill, columns)
                     else:
-                        self._mapped_project.append("*")
-
-                for group in self._groups:
-                    # if we have a number, use it as an column offset
-                    if isinstance(group, int):
-                        group = self._positions[group - 1]
-                    self._mapped_groups.append(
-                        columns.get_column_from_alias(group, only_one=True)
+                        results = _read_spilled_partitions()
+                    yield from self._emit(results, columns, None)
+                return
+
+            if len(partials) == 0:
+                # count should return 0 rather than nothing
+                if self._is_single_count():
+                    results = [self._empty_count(first_page, columns)]
+                else:
+                    results = []
+            else:
+                # phase two - partition the states by the group keys and merge the
+                # partitions in parallel
+                combined = pyarrow.concat_tables(partials)
+                partitions = 1
+                if combined.num_rows > PARTITION_THRESHOLD:
+                    partitions = MAX_WORKER_THREADS
+                partitioned = partition_table(combined, self._mapped_groups, partitions)
+                results = list(
+                    pool.map(
+                        lambda partition: self._merge_and_finalize(
+                            [partition], columns
+                        ),
+                        (p for p in partitioned if p.num_rows > 0),
                     )
+                )
+                if self._grouping_sets:
+                    results = self._finalize_grouping_sets(results, columns)
 
-            for group in _map(page, self._mapped_project):
+        expected_rows = sum(table.num_rows for table in results)
+        yield from self._emit(results, columns, expected_rows)
 
-                for aggregrator in self._aggregates:
+    def _execute_ordered(self, data_pages):
+        """
+        When the data is ordered by the group keys, a group is complete when we see
+        the next group, so rather than collecting all of the groups, we only carry
+        the last group of each page to the next page and emit the others.
 
-                    attribute = aggregrator["args"][0][0]
-                    if attribute == "Wildcard":
-                        mapped_attribute = "*"
-                    else:
-                        mapped_attribute = columns.get_column_from_alias(
-                            attribute, only_one=True
-                        )
-                    function = aggregrator["aggregate"]
-                    column_name = f"{function}({attribute})"
-                    value = [v for k, v in group if k == mapped_attribute]
-                    if len(value) == 1:
-                        value = value[0]
-
-                    # this is needed for situations where the select column isn't selecting
-                    # the columns in the group by
-                    # fmt:off
-                    collection = tuple([(k,v,) for k, v in group if k in self._mapped_groups])
-                    try:
-                        group_collector = collector[collection]
-                    except TypeError:
-                        raise SqlError("GROUP BY contains one or more columns which is a list or struct, cannot GROUP BY lists or structs.")
-                    # fmt:on
-
-                    # Add the responses to the collector if it's COUNT(*)
-                    if column_name == "COUNT(Wildcard)":
-                        if COUNT_STAR in group_collector:
-                            group_collector[COUNT_STAR] += 1
-                        else:
-                            group_collector[COUNT_STAR] = 1
-                    elif function == "COUNT":
-                        if value:
-                            if column_name in group_collector:
-                                group_collector[column_name] += 1
-                            else:
-                                group_collector[column_name] = 1
-                    # if this is one of the functions we do an incremental aggregate
-                    elif function in INCREMENTAL_AGGREGATES:
-                        # if we have information about this collection
-                        if column_name in group_collector:
-                            group_collector[column_name] = _incremental(
-                                value,
-                                group_collector[column_name],
-                                function,
-                            )
-                        # otherwise, it's new, so seed the collection with the initial value
-                        else:
-                            group_collector[column_name] = value
-                    if function in WHOLE_AGGREGATES:
-                        if (function, column_name) in group_collector:
-                            group_collector[(function, column_name)].append(value)
-                        else:
-                            group_collector[(function, column_name)] = [value]
-
-                    collector[collection] = group_collector
-
-        # count should return 0 rather than nothing
-        if len(collector) == 0 and len(self._aggregates) == 1:
-            if self._aggregates[0]["aggregate"] == "COUNT":
-                collector = {
-                    tuple((g, None) for g in self._mapped_groups): {COUNT_STAR: 0}
-                }
+        The pages are still pre-aggregated by the workers, the results are collected
+        in page order. pyarrow keeps the groups in the order they first appear.
+        """
+        columns = None
+        first_page = None
+        carry = None
+        pending: deque = deque()
+
+        def _complete_groups(future):
+            nonlocal carry
+            partial = future.result()
+            if carry is not None:
+                partial = self._merge([carry, partial])
+            carry = partial.slice(partial.num_rows - 1)
+            if partial.num_rows > 1:
+                yield self._finalize(partial.slice(0, partial.num_rows - 1), columns)
 
+        def _results():
+            nonlocal columns, first_page
+            with ThreadPoolExecutor(max_workers=MAX_WORKER_THREADS) as pool:
+                for page in data_pages.execute():
+                    if columns is None:
+                        columns = Columns(page)
+                        first_page = page
+                        self._map_columns(columns, page)
+
+                    if page.num_rows == 0:
+                        continue
+
+                    pending.append(pool.submit(self._partial, page))
+                    while len(pending) > MAX_PAGES_IN_FLIGHT:
+                        yield from _complete_groups(pending.popleft())
+
+                while pending:
+                    yield from _complete_groups(pending.popleft())
+
+            if carry is not None:
+                yield self._finalize(carry, columns)
+            elif columns is not None:
+                # count should return 0 rather than nothing
+                if self._is_single_count():
+                    yield self._empty_count(first_page, columns)
+
+        results = _results()
+        first = next(results, None)
+        if first is None:
+            return
+        yield from self._emit(itertools.chain([first], results), columns, None)
+
+    def _emit(self, results, columns, expected_rows):
+        """
+        add the column metadata to the result tables, small tables are combined so
+        the results are a few large pages, the metadata is built once and the
+        other pages reuse its schema
+        """
+        schema = None
         buffer: List = []
-        metadata = None
-        for collected, record in collector.items():
-            if len(buffer) > 1000:  # pragma: no cover
-                table = pyarrow.Table.from_pylist(buffer)
-                if metadata is None:
-                    table = Columns.create_table_metadata(
-                        table=table,
-                        expected_rows=len(collector),
-                        name=columns.table_name,
-                        table_aliases=[],
-                    )
-                    metadata = Columns(table)
-                else:
-                    table = metadata.apply(table)
-                yield table
-                buffer = []
-            for field, value in collected:
-                mapped_field = columns.get_preferred_name(field)
-                if hasattr(value, "as_py"):
-                    value = value.as_py()  # type:ignore
-                for agg in list(record.keys()):
-                    if isinstance(agg, tuple):
-                        func, col = agg
-                        if func in WHOLE_AGGREGATES:
-                            record[col] = WHOLE_AGGREGATES[func](
-                                record.pop(agg)
-                            )  # type:ignore
-                record[mapped_field] = value
-            buffer.append(record)
-
-        if len(buffer) > 0:
-            table = pyarrow.Table.from_pylist(buffer)
-            if metadata is None:
+        buffered_rows = 0
+
+        def _page():
+            nonlocal schema
+            table = pyarrow.concat_tables(buffer) if len(buffer) > 1 else buffer[0]
+            if schema is None:
                 table = Columns.create_table_metadata(
                     table=table,
-                    expected_rows=len(collector),
+                    expected_rows=expected_rows,
                     name=columns.table_name,
                     table_aliases=[],
                 )
-                metadata = Columns(table)
-            else:
-                table = metadata.apply(table)
-            yield table
+                schema = table.schema
+                return table
+            return pyarrow.Table.from_arrays(table.columns, schema=schema)
+
+        for table in results:
+            buffer.append(table)
+            buffered_rows += table.num_rows
+            if buffered_rows >= OUTPUT_PAGE_ROWS:
+                yield _page()
+                buffer = []
+                buffered_rows = 0
+        if buffer:
+            yield _page()
@@ -18,6 +18,7 @@ This is a SQL Query Execution Plan Node.
 This Node reads and parses the data from a dataset into a Table.
 """
 import datetime
+import operator
 import time
 
 from typing import Iterable
@@ -25,12 +26,13 @@ from enum import Enum
 from cityhash import CityHash64
 
 import pyarrow
+import pyarrow.compute
 
 from opteryx import config
 from opteryx.engine import QueryDirectives, QueryStatistics
 from opteryx.engine.planner.operations import BasePlanNode
 from opteryx.exceptions import DatabaseError
-from opteryx.storage import file_decoders
+from opteryx.storage import file_decoders, manifest
 from opteryx.storage.adapters import DiskStorage
 from opteryx.storage.schemes import MabelPartitionScheme
 from opteryx.storage.schemes import DefaultPartitionScheme
@@ -46,6 +48,7 @@ class ExtentionType(str, Enum):
 
 do_nothing = lambda x, y: x
 
+MANIFEST_PATH = config.MANIFEST_PATH
 MAX_SIZE_SINGLE_CACHE_ITEM = config.MAX_SIZE_SINGLE_CACHE_ITEM
 PARTITION_SCHEME = config.PARTITION_SCHEME
 
@@ -60,6 +63,20 @@ KNOWN_EXTENSIONS = {
     "zstd": (file_decoders.zstd_decoder, ExtentionType.DATA),  # jsonl/zstd
 }
 
+STATISTICS_READERS = file_decoders.STATISTICS_READERS
+
+# the comparisons which can be pushed to the decoders
+COMPARISONS = {
+    "=": operator.eq,
+    ">": operator.gt,
+    ">=": operator.ge,
+    "<": operator.lt,
+    "<=": operator.le,
+}
+
+# the aggregates we can answer from the file metadata
+METADATA_AGGREGATES = {"COUNT", "MIN", "MINIMUM", "MAX", "MAXIMUM"}
+
 
 def _normalize_to_schema(table, schema):
     """
@@ -121,6 +138,28 @@ def _normalize_to_types(table):
     return table.cast(target_schema=schema), schema
 
 
+def _to_expression(predicates):
+    """
+    Convert the (column, operator, value) conditions pushed from the WHERE clause to
+    an expression the decoders can filter with, all of the conditions must be true.
+    """
+    if not predicates:
+        return None
+    expression = None
+    for column, operator, value in predicates:
+        field = pyarrow.compute.field(column)
+        if operator == "IsNull":
+            condition = field.is_null(nan_is_null=True)
+        elif operator == "IsNotNull":
+            condition = ~field.is_null(nan_is_null=True)
+        elif operator == "in":
+            condition = field.isin(value)
+        else:
+            condition = COMPARISONS[operator](field, pyarrow.scalar(value))
+        expression = condition if expression is None else expression & condition
+    return expression
+
+
 class BlobReaderNode(BasePlanNode):
 
     _disable_cache = False
@@ -139,6 +178,13 @@ class BlobReaderNode(BasePlanNode):
         self._dataset = config.get("dataset", None)
         self._alias = config.get("alias", None)
 
+        # pushed down OFFSET and LIMIT, only pushed when reading from storage
+        self._scan_limit = config.get("scan_limit")
+        # the columns referenced by the query, the decoders only read these columns
+        self._projection = config.get("projection")
+        if self._projection is not None:
+            self._projection = sorted(self._projection)
+
         # circular imports
         from opteryx.engine.planner.planner import QueryPlanner
 
@@ -166,8 +212,10 @@ class BlobReaderNode(BasePlanNode):
         self._start_date = config.get("start_date", today)
         self._end_date = config.get("end_date", today)
 
-        # pushed down selection/filter
-        self._selection = config.get("selection")
+        # pushed down selection/filter, the Selection Node still applies the full
+        # filter, this is to avoid reading data we know we don't need
+        self._predicates = config.get("selection") or []
+        self._selection = _to_expression(self._predicates)
 
         # scan
         self._reading_list = self._scanner()
@@ -180,10 +228,14 @@ class BlobReaderNode(BasePlanNode):
         use_cache = ""
         if self._disable_cache:
             use_cache = " (NO_CACHE)"
+        scan_limit = ""
+        if self._scan_limit:
+            offset, limit = self._scan_limit
+            scan_limit = f" (LIMIT {limit}{f' OFFSET {offset}' if offset else ''})"
         if self._alias:
-            return f"{self._dataset} => {self._alias}{use_cache}"
+            return f"{self._dataset} => {self._alias}{use_cache}{scan_limit}"
         if isinstance(self._dataset, str):
-            return f"{self._dataset}{use_cache}"
+            return f"{self._dataset}{use_cache}{scan_limit}"
         return "<complex dataset>"
 
     @property
@@ -211,8 +263,6 @@ class BlobReaderNode(BasePlanNode):
         schema = None
 
         #        import pyarrow.plasma as plasma
-        from opteryx.storage import multiprocessor
-
         # from opteryx import config
 
         #        with plasma.start_plasma_store(
@@ -222,8 +272,21 @@ class BlobReaderNode(BasePlanNode):
         if not metadata:
             plasma_channel = None
 
+            if self._scan_limit is not None:
+                self._rows_to_skip, self._rows_to_read = self._scan_limit
+                self._read_a_blob = False
+
             for partition in self._reading_list.values():
 
+                # we've read all of the rows we need, we always read one blob so
+                # we know the schema
+                if (
+                    self._scan_limit is not None
+                    and self._rows_to_read == 0
+                    and self._read_a_blob
+                ):
+                    break
+
                 # we're reading this partition now
                 self._statistics.partitions_read += 1
 
@@ -232,14 +295,7 @@ class BlobReaderNode(BasePlanNode):
                     blob_bytes,
                     pyarrow_blob,
                     path,
-                ) in multiprocessor.processed_reader(
-                    self._read_and_parse,
-                    [
-                        (path, self._reader.read_blob, parser, self._cache)
-                        for path, parser in sorted(partition["blob_list"])
-                    ],
-                    plasma_channel,
-                ):
+                ) in self._read_partition(partition, plasma_channel):
 
                     # we're going to open this blob
                     self._statistics.count_data_blobs_read += 1
@@ -258,6 +314,7 @@ class BlobReaderNode(BasePlanNode):
                         self._row_count = pyarrow_blob.num_rows * (
                             self._statistics.count_blobs_found
                             - self._statistics.count_blobs_ignored_frames
+                            - self._statistics.count_blobs_pruned
                             - self._statistics.count_control_blobs_found
                             - self._statistics.count_unknown_blob_type_found
                         )
@@ -290,6 +347,189 @@ class BlobReaderNode(BasePlanNode):
                     # yield this blob
                     yield pyarrow_blob
 
+    def _read_statistics(self):
+        """
+        Read the statistics from the metadata of each of the blobs, returns None if
+        any of the blobs don't have metadata we can use.
+        """
+        collected = []
+        for partition in self._reading_list.values():
+            for path, _ in partition["blob_list"]:
+                statistics_reader = STATISTICS_READERS.get(path.split(".")[-1])
+                if statistics_reader is None:
+                    return None
+                start_read = time.time_ns()
+                stream = self._reader.open_blob(path)
+                try:
+                    collected.append(statistics_reader(stream))
+                finally:
+                    stream.close()
+                self._statistics.time_data_read += time.time_ns() - start_read
+        return collected
+
+    def aggregate_from_metadata(self, aggregates):
+        """
+        Answer COUNT(*), COUNT, MIN and MAX aggregates from the metadata in the file
+        footers, without reading and decoding the data in the files.
+
+        The aggregates are a list of (function, column) tuples, the column is None for
+        COUNT(*). Returns a list of single-value arrays, or None if the aggregates
+        can't be answered from the metadata.
+        """
+        if not isinstance(self._dataset, str):
+            return None
+        if any(function not in METADATA_AGGREGATES for function, _ in aggregates):
+            return None
+
+        # the columns may be qualified with the table name or alias
+        prefixes = {self._alias, self._dataset.replace("/", ".")[:-1]}
+        requested = []
+        for function, column in aggregates:
+            if column is not None and "." in column:
+                prefix, name = column.rsplit(".", 1)
+                if prefix in prefixes:
+                    column = name
+            if column is None and function != "COUNT":
+                return None
+            requested.append((function, column))
+
+        collected = self._read_statistics()
+        if not collected:
+            return None
+
+        results = []
+        for function, column in requested:
+            if column is None:
+                value = sum(blob["num_rows"] for blob in collected)
+                results.append(pyarrow.array([value], type=pyarrow.int64()))
+                continue
+
+            summaries = [blob["columns"].get(column) for blob in collected]
+            if any(summary is None for summary in summaries):
+                return None
+
+            if function == "COUNT":
+                value = sum(
+                    blob["num_rows"] - summary["null_count"]
+                    for blob, summary in zip(collected, summaries)
+                )
+                results.append(pyarrow.array([value], type=pyarrow.int64()))
+                continue
+
+            key = "min" if function in ("MIN", "MINIMUM") else "max"
+            if any(
+                key not in summary and summary["null_count"] != blob["num_rows"]
+                for blob, summary in zip(collected, summaries)
+            ):
+                return None
+            values = [s[key] for s in summaries if s.get(key) is not None]
+            value = None
+            if values:
+                value = min(values) if key == "min" else max(values)
+            array = pyarrow.array([value], type=summaries[0]["type"])
+            # dates are read as timestamps
+            if str(array.type) in ("date32[day]", "date64"):
+                array = array.cast(pyarrow.timestamp("us"))
+            results.append(array)
+
+        self._statistics.partitions_read += len(self._reading_list)
+        self._statistics.count_data_blobs_read += len(collected)
+        self._statistics.count_blobs_read_from_metadata += len(collected)
+        return results
+
+    def _read_partition(self, partition, plasma_channel):
+        from opteryx.storage import multiprocessor
+
+        if self._scan_limit is not None:
+            yield from self._read_limited(partition)
+            return
+
+        yield from multiprocessor.processed_reader(
+            self._read_and_parse,
+            [
+                (path, self._reader.read_blob, parser, self._cache)
+                for path, parser in sorted(partition["blob_list"])
+            ],
+            plasma_channel,
+        )
+
+    def _read_limited(self, partition):
+        """
+        Read the blobs when the OFFSET and LIMIT have been pushed to the reader.
+
+        Blobs are read in order until we have the rows we need, blobs which are all
+        within the OFFSET are skipped using the row count in their footer (when they
+        have one) and the decoders stop decoding once they have the rows we need, so
+        only the start of the blobs is read.
+        """
+        for path, parser in sorted(partition["blob_list"]):
+
+            if self._rows_to_read == 0 and self._read_a_blob:
+                return
+
+            start_read = time.time_ns()
+
+            # the number of rows the decoder skips
+            offset = 0
+            if self._rows_to_skip > 0:
+                statistics_reader = STATISTICS_READERS.get(path.split(".")[-1])
+                if statistics_reader is not None:
+                    stream = self._reader.open_blob(path)
+                    try:
+                        row_count = statistics_reader(stream)["num_rows"]
+                    finally:
+                        stream.close()
+                    # we always read one blob so we know the schema
+                    if row_count <= self._rows_to_skip and self._read_a_blob:
+                        self._rows_to_skip -= row_count
+                        self._statistics.count_blobs_read_from_metadata += 1
+                        self._statistics.time_data_read += time.time_ns() - start_read
+                        continue
+                    offset = min(self._rows_to_skip, row_count)
+
+            # the blob may already be in the cache, but we don't populate the cache
+            # as we're only reading part of the blob
+            blob_bytes = None
+            if self._cache:
+                try:
+                    blob_bytes = self._cache.get(format(CityHash64(path), "X"))
+                except Exception:  # pragma: no cover
+                    blob_bytes = None
+            if blob_bytes is not None:
+                self._statistics.cache_hits += 1
+                stream = blob_bytes
+                bytes_read = blob_bytes.getbuffer().nbytes
+            else:
+                stream = self._reader.open_blob(path)
+                bytes_read = 0
+
+            try:
+                table = parser(
+                    stream,
+                    self._projection,
+                    offset=offset,
+                    limit=self._rows_to_skip - offset + self._rows_to_read,
+                )
+            finally:
+                # the stream is only part read, we record the position the read
+                # finished at
+                if blob_bytes is None:
+                    try:
+                        bytes_read = stream.tell()
+                    except (AttributeError, OSError, ValueError):  # pragma: no cover
+                        pass
+                    stream.close()
+
+            # if we don't know how many rows the blob has, the decoder can't skip the
+            # rows in the offset, so we skip them now
+            skipped = min(self._rows_to_skip - offset, table.num_rows)
+            table = table.slice(skipped)
+            self._rows_to_skip -= offset + skipped
+            self._rows_to_read -= table.num_rows
+
+            self._read_a_blob = True
+            yield time.time_ns() - start_read, bytes_read, table, path
+
     def _read_and_parse(self, config):
         path, reader, parser, cache = config
         start_read = time.time_ns()
@@ -323,7 +563,7 @@ class BlobReaderNode(BasePlanNode):
         else:
             blob_bytes = reader(path)
 
-        table = parser(blob_bytes, None)
+        table = parser(blob_bytes, self._projection, selection=self._selection)
 
         time_to_read = time.time_ns() - start_read
         return time_to_read, blob_bytes.getbuffer().nbytes, table, path
@@ -396,6 +636,10 @@ class BlobReaderNode(BasePlanNode):
                 else:
                     self._statistics.count_unknown_blob_type_found += 1
 
+            # skip the blobs the manifest shows can't match the selection
+            if MANIFEST_PATH and self._predicates:
+                self._prune_blobs(partition, partition_structure[partition])
+
             if len(partition_structure[partition]["blob_list"]) == 0:
                 partition_structure.pop(partition)
 
@@ -403,3 +647,22 @@ class BlobReaderNode(BasePlanNode):
             raise DatabaseError("No blobs found that match the requested dataset.")
 
         return partition_structure
+
+    def _prune_blobs(self, partition, structure):
+        """
+        Remove the blobs which the zone maps in the partition manifest show can't have
+        rows matching the selection, we always keep one blob so we know the schema.
+        """
+        blob_list = structure["blob_list"]
+        entries = manifest.get_manifest(
+            MANIFEST_PATH, self._reader, partition, [name for name, _ in blob_list]
+        )
+        kept = [
+            (name, decoder)
+            for name, decoder in blob_list
+            if manifest.can_match(entries[name], self._predicates)
+        ]
+        if not kept:
+            kept = sorted(blob_list)[:1]
+        self._statistics.count_blobs_pruned += len(blob_list) - len(kept)
+        structure["blob_list"] = kept
@@ -16,15 +16,205 @@ Distinct Node
 This is a SQL Query Execution Plan Node.
 
 This Node eliminates duplicate records.
+
+This is a streaming operator, the rows of each page which haven't been seen before
+are emitted as the page is read. The rows which have been seen are recorded in a hash
+set, matching hashes are confirmed by comparing the values so hash collisions don't
+remove rows.
+
+DISTINCT ON (columns) keeps the first row for each of the values of the columns.
+
+If the set of seen rows exceeds the memory budget, the seen rows and the rest of the
+data are written, partitioned by the hash of the rows, to spill files on local disk.
+Each partition is then read back and deduplicated, one partition at a time.
 """
-from typing import Iterable
+from typing import Iterable, List
 
-from pyarrow import Table, concat_tables
+import numpy
+import pyarrow
+from pyarrow import Table, compute
 
+from opteryx import config
 from opteryx.engine.planner.operations import BasePlanNode
 from opteryx.engine import QueryDirectives, QueryStatistics
 from opteryx.exceptions import SqlError
-from opteryx.third_party.pyarrow_ops import drop_duplicates
+from opteryx.utils.arrow import hash_columns, partition_table
+from opteryx.utils.columns import Columns
+from opteryx.utils.spill import SpillFiles
+
+# when the seen rows exceed this size, they're written to disk
+MAX_OPERATOR_MEMORY = config.MAX_OPERATOR_MEMORY
+# the number of partitions rows are spilled to
+SPILL_PARTITIONS = 64
+# the seen keys are combined into one chunk when they have more chunks than this
+MAX_KEY_CHUNKS = 64
+
+
+def _values_equal(left, right):
+    """compare two arrays, nulls equal nulls and NaNs equal NaNs"""
+    if pyarrow.types.is_nested(left.type):
+        return numpy.array(
+            [a == b for a, b in zip(left.to_pylist(), right.to_pylist())], dtype=bool
+        )
+    equal = compute.fill_null(compute.equal(left, right), False)
+    equal = compute.or_(equal, compute.and_(left.is_null(), right.is_null()))
+    if pyarrow.types.is_floating(left.type):
+        equal = compute.or_(
+            equal,
+            compute.fill_null(
+                compute.and_(compute.is_nan(left), compute.is_nan(right)), False
+            ),
+        )
+    return equal.to_numpy(zero_copy_only=False)
+
+
+class DistinctSet:
+    """
+    The set of the values of the key columns which have been seen.
+
+    The hashes of the seen rows are held in sorted runs, alongside the position of
+    the row in the table of seen keys, so we can check if a hash has been seen and if
+    it has, confirm the values are the same.
+
+    Each page adds a new run, a run is merged with the run before it while that run
+    is no more than twice its size, so the runs grow geometrically - there are at
+    most log(n) runs and each hash is merged log(n) times, rather than the whole set
+    being copied for every page.
+    """
+
+    def __init__(self, columns: List[str]):
+        self.columns = columns
+        self.keys: Table = None
+        # (hashes, positions) pairs, each sorted by hash
+        self.runs: List = []
+
+    @property
+    def nbytes(self):
+        if self.keys is None:
+            return 0
+        return self.keys.nbytes + sum(h.nbytes + p.nbytes for h, p in self.runs)
+
+    def _rows_equal(self, page, rows, others, other_rows):
+        equal = numpy.ones(len(rows), dtype=bool)
+        for column in self.columns:
+            left = page.column(column).take(rows)
+            right = others.column(column).take(other_rows)
+            if isinstance(left, pyarrow.ChunkedArray):
+                left = left.combine_chunks()
+            if isinstance(right, pyarrow.ChunkedArray):
+                right = right.combine_chunks()
+            equal &= _values_equal(left, right)
+        return equal
+
+    def _in_run(self, run, page, rows, hashes):
+        """which of the rows, sorted by hash, have been seen in one of the runs"""
+        run_hashes, run_positions = run
+        starts = numpy.searchsorted(run_hashes, hashes, side="left")
+        found = starts < len(run_hashes)
+        found[found] = run_hashes[starts[found]] == hashes[found]
+        candidates = numpy.flatnonzero(found)
+        seen = numpy.zeros(len(rows), dtype=bool)
+        if len(candidates) == 0:
+            return seen
+        seen[candidates] = self._rows_equal(
+            page,
+            rows[candidates],
+            self.keys,
+            run_positions[starts[candidates]],
+        )
+        # hashes which have more than one set of values (collisions) are rare,
+        # these are checked one at a time
+        for candidate in candidates[~seen[candidates]]:
+            entry = starts[candidate] + 1
+            while entry < len(run_hashes) and run_hashes[entry] == hashes[candidate]:
+                if self._rows_equal(
+                    page,
+                    rows[candidate : candidate + 1],
+                    self.keys,
+                    run_positions[entry : entry + 1],
+                )[0]:
+                    seen[candidate] = True
+                    break
+                entry += 1
+        return seen
+
+    def _in_seen(self, page, rows, hashes):
+        """which of the rows (with distinct hashes) have already been seen"""
+        # looking up sorted hashes is much faster, the lookups are close together
+        order = numpy.argsort(hashes)
+        rows, hashes = rows[order], hashes[order]
+        seen = numpy.zeros(len(rows), dtype=bool)
+        for run in self.runs:
+            unseen = numpy.flatnonzero(~seen)
+            if len(unseen) == 0:
+                break
+            seen[unseen] = self._in_run(run, page, rows[unseen], hashes[unseen])
+        in_seen = numpy.empty(len(rows), dtype=bool)
+        in_seen[order] = seen
+        return in_seen
+
+    def _add(self, page, rows, hashes):
+        keys = page.select(self.columns).take(rows)
+        offset = 0 if self.keys is None else self.keys.num_rows
+        if self.keys is None:
+            self.keys = keys
+        else:
+            self.keys = pyarrow.concat_tables([self.keys, keys])
+            # looking up rows across lots of small chunks is slow
+            if self.keys.column(0).num_chunks > MAX_KEY_CHUNKS:
+                self.keys = self.keys.combine_chunks()
+        order = numpy.argsort(hashes, kind="stable")
+        self.runs.append((hashes[order], order + offset))
+        # merge the new run into the runs before it which aren't much larger
+        while len(self.runs) > 1 and len(self.runs[-2][0]) <= 2 * len(self.runs[-1][0]):
+            (left_hashes, left_positions), (right_hashes, right_positions) = (
+                self.runs.pop(-2),
+                self.runs.pop(),
+            )
+            merged_hashes = numpy.concatenate((left_hashes, right_hashes))
+            merged_positions = numpy.concatenate((left_positions, right_positions))
+            # the stable sort of two sorted runs is a single merge pass
+            order = numpy.argsort(merged_hashes, kind="stable")
+            self.runs.append((merged_hashes[order], merged_positions[order]))
+
+    def new_rows(self, page: Table):
+        """
+        the positions of the rows in the page which haven't been seen before, these
+        are added to the set
+        """
+        hashes = hash_columns(page, self.columns)
+        pending = numpy.arange(page.num_rows)
+        new_rows = []
+
+        while len(pending) > 0:
+            # the first row for each hash leads, the others follow it
+            _, first, inverse = numpy.unique(
+                hashes[pending], return_index=True, return_inverse=True
+            )
+            leaders = pending[numpy.sort(first)]
+            is_leader = numpy.zeros(len(pending), dtype=bool)
+            is_leader[first] = True
+            followers = pending[~is_leader]
+            leader_of_followers = pending[first[inverse[~is_leader]]]
+
+            # followers with the same values as their leader are duplicates, the
+            # others have colliding hashes and are checked in the next round
+            if len(followers) > 0:
+                duplicates = self._rows_equal(
+                    page, followers, page, leader_of_followers
+                )
+                pending = followers[~duplicates]
+            else:
+                pending = followers
+
+            leaders = leaders[~self._in_seen(page, leaders, hashes[leaders])]
+            if len(leaders) > 0:
+                self._add(page, leaders, hashes[leaders])
+                new_rows.append(leaders)
+
+        if len(new_rows) == 0:
+            return numpy.array([], dtype=numpy.int64)
+        return numpy.sort(numpy.concatenate(new_rows))
 
 
 class DistinctNode(BasePlanNode):
@@ -33,19 +223,28 @@ class DistinctNode(BasePlanNode):
     ):
         super().__init__(directives=directives, statistics=statistics)
         self._distinct = config.get("distinct", True)
+        self._on = config.get("on")
 
     @property
     def config(self):  # pragma: no cover
+        if self._on:
+            return f"ON ({', '.join(self._on)})"
         return ""
 
     @property
     def greedy(self):  # pragma: no cover
-        return True
+        return False
 
     @property
     def name(self):  # pragma: no cover
         return "Distinction"
 
+    def _key_columns(self, page):
+        if not self._on:
+            return page.column_names
+        columns = Columns(page)
+        return [columns.get_column_from_alias(c, only_one=True) for c in self._on]
+
     def execute(self) -> Iterable:
 
         if len(self._producers) != 1:
@@ -55,7 +254,71 @@ class DistinctNode(BasePlanNode):
         if isinstance(data_pages, Table):
             data_pages = (data_pages,)
 
-        if self._distinct:
-            yield drop_duplicates(concat_tables(data_pages.execute()))
+        if not self._distinct:
+            yield from data_pages.execute()
             return
-        yield from data_pages
+
+        seen = None
+        spill = None
+        first_page = None
+        emitted = False
+
+        for page in data_pages.execute():
+
+            if seen is None and spill is None:
+                first_page = page
+                keys = self._key_columns(page)
+                seen = DistinctSet(keys)
+
+            if page.num_rows == 0:
+                continue
+
+            if spill is not None:
+                for partition, table in enumerate(
+                    partition_table(page, keys, SPILL_PARTITIONS)
+                ):
+                    spill.write(partition, table)
+                continue
+
+            rows = seen.new_rows(page)
+            if len(rows) > 0:
+                emitted = True
+                yield page.take(pyarrow.array(rows))
+
+            if seen.nbytes > MAX_OPERATOR_MEMORY:
+                # write the seen rows to disk, and the rest of the data after them,
+                # so each partition starts with the rows it has already seen
+                spill = SpillFiles(
+                    partitions=SPILL_PARTITIONS, prefix="opteryx-distinct-"
+                )
+                seen_spill = SpillFiles(
+                    partitions=SPILL_PARTITIONS, prefix="opteryx-distinct-"
+                )
+                for partition, table in enumerate(
+                    partition_table(seen.keys, keys, SPILL_PARTITIONS)
+                ):
+                    seen_spill.write(partition, table)
+                seen = None
+                self._statistics.spills += 1
+
+        if spill is not None:
+            with spill, seen_spill:
+                self._statistics.bytes_spilled += (
+                    spill.bytes_written + seen_spill.bytes_written
+                )
+                for partition in range(SPILL_PARTITIONS):
+                    table = spill.read(partition)
+                    previously_seen = seen_spill.read(partition)
+                    if table is None:
+                        continue
+                    partition_set = DistinctSet(keys)
+                    if previously_seen is not None:
+                        partition_set.new_rows(previously_seen)
+                    rows = partition_set.new_rows(table)
+                    if len(rows) > 0:
+                        emitted = True
+                        yield table.take(pyarrow.array(rows))
+
+        if not emitted and first_page is not None:
+            # we need to return a page, even if it's empty
+            yield first_page.slice(0, 0)
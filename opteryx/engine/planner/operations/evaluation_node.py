@@ -16,9 +16,17 @@ Evaluation Node
 This is a SQL Query Execution Plan Node.
 
 This performs aliases and resolves function calls.
+
+The function calls in the query are compiled to a list of steps when the plan is
+built, functions which are arguments to other functions are steps before the
+functions which use them. Each distinct call is one step, however many times it
+appears in the query, so a call used in the SELECT and the GROUP BY clauses is only
+evaluated once for each page, and calls with only literal arguments are evaluated
+once, when the plan is built, and repeated for each page.
 """
-from typing import Iterable
+from typing import Dict, Iterable, List
 
+import numpy
 import pyarrow
 
 from opteryx.engine.attribute_types import TOKEN_TYPES
@@ -29,6 +37,188 @@ from opteryx.exceptions import SqlError
 from opteryx.utils.columns import Columns
 
 
+def _column_name(function: dict) -> str:
+    args = [
+        ((f"({','.join(a[0])})",) if isinstance(a[0], list) else a)
+        for a in function["args"]
+    ]
+    return f"{function['function']}({','.join(str(a[0]) for a in args)})"
+
+
+def _is_function(arg) -> bool:
+    return len(arg) == 3 and isinstance(arg[2], dict)
+
+
+def _existing_column(page, columns: Columns, column_name: str):
+    """the column in the page which has already been calculated, if there is one"""
+    existing = columns.get_column_from_alias(column_name)
+    if len(existing) == 1 and existing[0] in page.column_names:
+        return existing[0]
+    return None
+
+
+def _to_arrow(values):
+    if isinstance(values, pyarrow.ChunkedArray):
+        return values.combine_chunks()
+    return values
+
+
+def _to_array(values, return_type, num_rows: int):
+    """the functions return values in a few forms, convert them to an array"""
+    if isinstance(values, (pyarrow.Array, pyarrow.ChunkedArray)):
+        if return_type and values.type != return_type:
+            return values.cast(return_type)
+        return values
+    if return_type:
+        return pyarrow.array(values, type=return_type)
+    if isinstance(values, pyarrow.Scalar):
+        return pyarrow.array([values.as_py()] * num_rows, type=values.type)
+    if isinstance(values, numpy.ndarray):
+        return pyarrow.array(values)
+    # lists and generators are chunks of values
+    return pyarrow.array([value for chunk in values for value in chunk])
+
+
+class Expressions:
+    """
+    The function calls in a query, as steps which are evaluated in order.
+    """
+
+    def __init__(self, functions: Iterable[dict] = ()):
+        self._steps: Dict[str, dict] = {}
+        for function in functions:
+            self.add(function)
+
+    def __contains__(self, column_name):
+        return column_name in self._steps
+
+    def __len__(self):
+        return len(self._steps)
+
+    def __iter__(self):
+        return iter(self._steps)
+
+    def add(self, function: dict, column_name: str = None) -> str:
+        """add a function call and the calls in its arguments, returns its name"""
+        if function["function"] not in FUNCTIONS:
+            raise SqlError(
+                f"Function not known or not supported - {function['function']}"
+            )
+        if column_name is None:
+            column_name = _column_name(function)
+        if column_name in self._steps:
+            return column_name
+
+        args = []
+        for arg in function["args"]:
+            if _is_function(arg):
+                # functions as arguments are their own steps
+                args.append((self.add(arg[2], str(arg[0])), TOKEN_TYPES.IDENTIFIER))
+            else:
+                args.append(arg)
+
+        return_type, executor = FUNCTIONS[function["function"]]
+        step = {
+            "column_name": column_name,
+            "function": function["function"],
+            "args": args,
+            "return_type": return_type,
+            "executor": executor,
+            "constant": None,
+        }
+        step["constant"] = self._fold(step)
+        self._steps[column_name] = step
+        return column_name
+
+    def _fold(self, step):
+        """evaluate calls with only literal arguments now, rather than for each page"""
+        if len(step["args"]) == 0:
+            return None
+        arg_list = []
+        for arg in step["args"]:
+            if arg[1] == TOKEN_TYPES.IDENTIFIER:
+                constant = self._steps.get(arg[0], {}).get("constant")
+                if constant is None:
+                    return None
+                arg_list.append(constant)
+            else:
+                arg_list.append(arg[0])
+        try:
+            constant = _to_array(step["executor"](*arg_list), step["return_type"], 1)
+        except Exception:  # pylint: disable=broad-except
+            # leave it to fail when the query is run
+            return None
+        if len(constant) != 1:
+            return None
+        return constant
+
+    def evaluate(self, page, columns: Columns, column_names: List[str] = None):
+        """
+        Evaluate the steps needed for the named functions (or all of the functions)
+        for a page, functions which are already columns in the page are reused.
+        """
+        if column_names is None:
+            column_names = list(self._steps)
+
+        needed: set = set()
+
+        def _need(column_name):
+            if column_name in needed or column_name not in self._steps:
+                return
+            needed.add(column_name)
+            if _existing_column(page, columns, column_name) is None:
+                for arg in self._steps[column_name]["args"]:
+                    if arg[1] == TOKEN_TYPES.IDENTIFIER:
+                        _need(arg[0])
+
+        for column_name in column_names:
+            _need(column_name)
+
+        results: Dict = {}
+        for column_name, step in self._steps.items():
+            if column_name not in needed:
+                continue
+            existing = _existing_column(page, columns, column_name)
+            if existing is not None:
+                results[column_name] = page[existing]
+                continue
+            if step["constant"] is not None:
+                results[column_name] = step["constant"].take(
+                    numpy.zeros(page.num_rows, dtype=numpy.int64)
+                )
+                continue
+
+            arg_list = []
+            # go through the arguments and build arrays of the values
+            for arg in step["args"]:
+                if arg[1] == TOKEN_TYPES.IDENTIFIER:
+                    if arg[0] in results:
+                        arg_list.append(_to_arrow(results[arg[0]]))
+                        continue
+                    # get the column from the dataset
+                    mapped_column = columns.get_column_from_alias(arg[0], only_one=True)
+                    arg_list.append(_to_arrow(page[mapped_column]))
+                else:
+                    # it's a literal, just add it
+                    arg_list.append(arg[0])
+
+            # if there are no parameters, we pass the number of rows
+            if len(arg_list) == 0:
+                arg_list = [page.num_rows]
+
+            results[column_name] = _to_array(
+                step["executor"](*arg_list), step["return_type"], page.num_rows
+            )
+
+        return {c: results[c] for c in column_names if c in results}
+
+    def describe(self):  # pragma: no cover
+        return [
+            step["column_name"] + (" (constant)" if step["constant"] else "")
+            for step in self._steps.values()
+        ]
+
+
 class EvaluationNode(BasePlanNode):
     def __init__(
         self, directives: QueryDirectives, statistics: QueryStatistics, **config
@@ -36,22 +226,15 @@ class EvaluationNode(BasePlanNode):
         super().__init__(directives=directives, statistics=statistics)
         projection = config.get("projection", [])
         self.functions = [c for c in projection if "function" in c]
-        self.aliases: list = []
+        self.expressions = Expressions()
 
         # work out what the columns are called
         for function in self.functions:
+            function["column_name"] = self.expressions.add(function)
 
-            if function["function"] not in FUNCTIONS:
-                raise SqlError(
-                    f"Function not known or not supported - {function['function']}"
-                )
-
-            args = [
-                ((f"({','.join(a[0])})",) if isinstance(a[0], list) else a)
-                for a in function["args"]
-            ]
-            column_name = f"{function['function']}({','.join(str(a[0]) for a in args)})"
-            function["column_name"] = column_name
+        # functions which aren't in the SELECT clause, e.g. in the GROUP BY clause
+        for function in config.get("functions", []):
+            self.expressions.add(function)
 
     @property
     def name(self):  # pragma: no cover
@@ -59,7 +242,7 @@ class EvaluationNode(BasePlanNode):
 
     @property
     def config(self):  # pragma: no cover
-        return f"{self.functions}"
+        return ", ".join(self.expressions.describe())
 
     def execute(self) -> Iterable:
 
@@ -71,49 +254,34 @@ class EvaluationNode(BasePlanNode):
             data_pages = (data_pages,)
 
         columns = None
+        added: List[str] = []
 
         for page in data_pages.execute():
 
-            if columns is None:
+            first_page = columns is None
+            if first_page:
                 columns = Columns(page)
+                added = [
+                    column_name
+                    for column_name in self.expressions
+                    if _existing_column(page, columns, column_name) is None
+                ]
 
-            # for function, calculate and add the column
-            for function in self.functions:
-                arg_list = []
-                # go through the arguments and build arrays of the values
-                for arg in function["args"]:
-                    # TODO: do we need to account for functions calling functions?
-                    if arg[1] == TOKEN_TYPES.IDENTIFIER:
-                        # get the column from the dataset
-                        mapped_column = columns.get_column_from_alias(
-                            arg[0], only_one=True
-                        )
-                        arg_list.append(page[mapped_column].to_numpy())
-                    else:
-                        # it's a literal, just add it
-                        arg_list.append(arg[0])
-
-                # if there are no parameters, we pass the number of rows
-                if len(arg_list) == 0:
-                    arg_list = [page.num_rows]
-
-                return_type, executor = FUNCTIONS[function["function"]]
-                calculated_values = executor(*arg_list)
-                if isinstance(calculated_values, (pyarrow.lib.StringScalar)):
-                    calculated_values = [[calculated_values.as_py()]]
-                if return_type:
-                    calculated_values = pyarrow.array(
-                        calculated_values, type=return_type
-                    )
+            # evaluate the functions, and add the columns we don't already have
+            results = self.expressions.evaluate(page, columns)
+            for column_name in added:
                 page = pyarrow.Table.append_column(
-                    page, function["column_name"], calculated_values
+                    page, column_name, results[column_name]
                 )
-                columns.add_column(function["column_name"])
-                for alias in function.get("alias", []):
-                    columns.add_alias(function["column_name"], alias)
-                page = columns.apply(page)
 
-            # for alias, add aliased column, do this after the functions because they
-            # could have aliases
+            if first_page:
+                for column_name in added:
+                    columns.add_column(column_name)
+                # for alias, add aliased column, do this after the functions because
+                # they could have aliases
+                for function in self.functions:
+                    for alias in function.get("alias", []):
+                        columns.add_alias(function["column_name"], alias)
+            page = columns.apply(page)
 
             yield page
@@ -15,7 +15,9 @@ Explain Node
 
 This is a SQL Query Execution Plan Node.
 
-This writes out a query plan
+This writes out a query plan, for EXPLAIN ANALYZE the query is executed first so the
+plan includes what the operators learned while executing (e.g. the order predicates
+were evaluated in).
 """
 from typing import Iterable
 
@@ -29,6 +31,7 @@ class ExplainNode(BasePlanNode):
     ):
         super().__init__(directives=directives, statistics=statistics)
         self._query_plan = config.get("query_plan")
+        self._analyze = config.get("analyze", False)
 
     @property
     def name(self):  # pragma: no cover
@@ -36,8 +39,13 @@ class ExplainNode(BasePlanNode):
 
     @property  # pragma: no cover
     def config(self):
+        if self._analyze:
+            return "ANALYZE"
         return ""
 
     def execute(self) -> Iterable:
         if self._query_plan:
+            if self._analyze:
+                for _ in self._query_plan.execute():
+                    pass
             yield from self._query_plan.explain()
@@ -0,0 +1,98 @@
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Heap Sort Node
+
+This is a SQL Query Execution Plan Node.
+
+This node orders a dataset and keeps only the first K rows, it is used in place of a
+Sort Node when there is a LIMIT (ORDER BY ... LIMIT K), K includes any OFFSET.
+
+Rather than collecting and sorting all of the data, the first K rows of each page are
+selected (without fully sorting the page) and merged with the best K rows seen so far,
+so only K rows are held between pages.
+"""
+from typing import Iterable
+
+from pyarrow import Table, compute, concat_tables
+
+from opteryx.engine.planner.operations.sort_node import SortNode
+from opteryx.engine import QueryDirectives, QueryStatistics
+from opteryx.exceptions import SqlError
+
+
+class HeapSortNode(SortNode):
+    def __init__(
+        self, directives: QueryDirectives, statistics: QueryStatistics, **config
+    ):
+        super().__init__(directives=directives, statistics=statistics, **config)
+        self._limit = config.get("limit")
+
+    @property
+    def config(self):  # pragma: no cover
+        return f"LIMIT = {self._limit} ORDER = " + ",".join(
+            [str(i) for i in self._order]
+        )
+
+    @property
+    def name(self):  # pragma: no cover
+        return "Heap Sort"
+
+    def execute(self) -> Iterable:
+
+        if len(self._producers) != 1:
+            raise SqlError(f"{self.name} on expects a single producer")
+
+        data_pages = self._producers[0]  # type:ignore
+        if isinstance(data_pages, Table):
+            data_pages = (data_pages,)
+
+        first_page = None
+        table = None
+        added_columns: list = []
+
+        for page in data_pages.execute():
+
+            if first_page is None:
+                first_page = page
+            if page.num_rows == 0:
+                continue
+
+            page, added_columns = self._map_order(page)
+
+            if self._limit == 0:
+                table = page.slice(0, 0)
+                continue
+
+            # select the first K rows of the page without sorting all of it
+            if page.num_rows > self._limit:
+                page = page.take(
+                    compute.select_k_unstable(
+                        page, k=self._limit, sort_keys=self._mapped_order
+                    )
+                )
+
+            # the rows we're keeping go first so ties keep their original order
+            if table is not None:
+                page = concat_tables([table, page])
+            table = page.sort_by(self._mapped_order).slice(0, self._limit)
+
+        if table is None:
+            if first_page is not None:
+                yield first_page.slice(0, 0)
+            return
+
+        if added_columns:
+            table = table.drop(added_columns)
+
+        yield table
@@ -54,8 +54,9 @@ class ProjectionNode(BasePlanNode):
                 # qualified wildcard, e.g. table.*
                 self._projection[(attribute["*"],)] = None
             elif "aggregate" in attribute:
+                distinct = "DISTINCT " if attribute.get("distinct") else ""
                 self._projection[
-                    f"{attribute['aggregate']}({','.join([replace_wildcards(a) for a in attribute['args']])})"
+                    f"{attribute['aggregate']}({distinct}{','.join([replace_wildcards(a) for a in attribute['args']])})"
                 ] = attribute["alias"]
 
             elif "function" in attribute:
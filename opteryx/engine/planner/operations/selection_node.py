@@ -25,12 +25,32 @@ This allows for non-trivial filters to be written with just tuples and lists.
 The predicates are in _tuples_ in the form (`key`, `op`, `value`) where the `key`
 is the value looked up from the record, the `op` is the operator and the `value`
 is a literal.
+
+Each predicate is evaluated to a boolean mask, using SQL's three-valued logic, a
+comparison involving a null is null (unknown), and the masks are combined using
+Kleene AND, OR and NOT, which work on the bitmaps a word at a time. The rows where
+the mask is true are then selected from the page with a single filter.
+
+The predicates in an AND list are reordered as pages are processed, using the time
+each predicate takes and the fraction of the rows it eliminates, so the cheapest and
+most selective predicates are evaluated first. Later predicates are only evaluated
+on the rows which haven't already been eliminated. The learned order is shown by
+EXPLAIN ANALYZE.
+
+Function calls in the predicates are replaced with references to columns when the
+plan is built, the functions are evaluated once for each page, before the predicates,
+and functions which have already been evaluated (e.g. because they are also in the
+SELECT clause) are not evaluated again.
+
+Selecting the rows copies every column of the page, the columns which are only
+referenced in the WHERE clause aren't needed after the rows are selected so they are
+dropped before the rows are selected rather than copied and dropped later. Pages where
+all of the rows are selected aren't copied.
 """
 import time
 
-from typing import Iterable, Union
-from pyarrow import Table
-from numpy import union1d, intersect1d
+from typing import Dict, Iterable, List, Union
+from pyarrow import Table, compute
 
 import numpy
 import pyarrow
@@ -40,10 +60,21 @@ from opteryx.engine.attribute_types import TOKEN_TYPES
 from opteryx.engine.functions import FUNCTIONS
 from opteryx.engine.functions.unary_operations import UNARY_OPERATIONS
 from opteryx.engine.planner.operations.base_plan_node import BasePlanNode
+from opteryx.engine.planner.operations.evaluation_node import Expressions
 from opteryx.exceptions import SqlError
+from opteryx.utils import patterns as string_patterns
 from opteryx.utils.columns import Columns
 from opteryx.utils.arrow import consolidate_pages
 
+# the rows being evaluated are reduced to the rows which haven't been eliminated when
+# fewer than this fraction of them remain
+REDUCE_ROWS_RATIO = 0.5
+# predicates which haven't been measured are measured on this many rows of the page,
+# when the page is much larger than this, before the order is decided
+SAMPLE_ROWS = 10000
+# comparisons, and IN lists, are unknown when either side is null
+COMPARISON_OPERATORS = {"=", "==", "!=", "<>", "<", ">", "<=", ">=", "in", "not in"}
+
 
 class InvalidSyntaxError(Exception):
     """
@@ -53,16 +84,259 @@ class InvalidSyntaxError(Exception):
     pass
 
 
-def _evaluate(predicate: Union[tuple, list], table: Table):
+class ConjunctionOrder:
+    """
+    The observed cost and selectivity of the predicates in an AND list.
+
+    Predicates are ordered by their cost per row divided by the fraction of rows they
+    eliminate, so a cheap predicate which eliminates most of the rows goes first and
+    an expensive predicate which eliminates few rows goes last. Predicates which
+    haven't been measured yet go first, so they are measured.
+    """
+
+    def __init__(self, size: int):
+        self.rows_in = [0] * size
+        self.rows_out = [0] * size
+        self.time = [0] * size
+
+    def record(self, index: int, rows_in: int, rows_out: int, time_ns: int):
+        self.rows_in[index] += rows_in
+        self.rows_out[index] += rows_out
+        self.time[index] += time_ns
+
+    def _rank(self, index):
+        if self.rows_in[index] == 0:
+            return 0
+        cost = self.time[index] / self.rows_in[index]
+        eliminated = 1 - (self.rows_out[index] / self.rows_in[index])
+        return cost / max(eliminated, 1e-6)
+
+    def measured(self, index: int):
+        return self.rows_in[index] > 0
+
+    def order(self):
+        return sorted(range(len(self.rows_in)), key=lambda i: (self._rank(i), i))
+
+    def selectivity(self, index):
+        """the fraction of the rows the predicate kept, None if not measured"""
+        if self.rows_in[index] == 0:
+            return None
+        return self.rows_out[index] / self.rows_in[index]
+
+
+def _referenced_columns(predicate, column_names, found):
+    """the columns in the table a predicate refers to"""
+    if isinstance(predicate, tuple):
+        if (
+            len(predicate) > 1
+            and predicate[1] == TOKEN_TYPES.IDENTIFIER
+            and predicate[0] in column_names
+        ):
+            found.add(predicate[0])
+        for part in predicate:
+            _referenced_columns(part, column_names, found)
+    elif isinstance(predicate, list):
+        for part in predicate:
+            _referenced_columns(part, column_names, found)
+    elif isinstance(predicate, dict):
+        # function arguments are aliases, which are resolved when the function is
+        # evaluated, so we keep all of the columns
+        found.update(column_names)
+    return found
+
+
+def _evaluate_conjunction(predicates: list, table: Table, orders: Dict):
+    """
+    AND a list of predicates together, in the order learned from the previous pages.
+
+    When most of the rows have been eliminated, the remaining predicates are evaluated
+    on just the rows which haven't been eliminated (including rows where the result
+    is unknown, as these may still be eliminated by a later predicate), this is
+    mapped back to a mask for all of the rows.
+    """
+    order = orders.get(id(predicates))
+    if order is None:
+        order = ConjunctionOrder(len(predicates))
+        orders[id(predicates)] = order
+
+    # measure the predicates we haven't seen on a sample of the page, so we have an
+    # order for the first page
+    if table.num_rows > SAMPLE_ROWS * 10:
+        sample = table.slice(0, SAMPLE_ROWS)
+        for index, predicate in enumerate(predicates):
+            if not order.measured(index):
+                start = time.perf_counter_ns()
+                part_mask = _evaluate(predicate, sample, orders)
+                kept = compute.sum(compute.fill_null(part_mask, True)).as_py() or 0
+                order.record(index, SAMPLE_ROWS, kept, time.perf_counter_ns() - start)
+
+    subset = table
+    mask = None
+    # the positions of the rows in the subset, None when it's all of the rows
+    positions = None
+
+    evaluation_order = order.order()
+    for step, index in enumerate(evaluation_order):
+        start = time.perf_counter_ns()
+        part_mask = _evaluate(predicates[index], subset, orders)
+        mask = part_mask if mask is None else compute.and_kleene(mask, part_mask)
+        remaining = compute.fill_null(mask, True)
+        rows_in, rows_out = subset.num_rows, compute.sum(remaining).as_py() or 0
+        order.record(index, rows_in, rows_out, time.perf_counter_ns() - start)
+
+        if rows_out == 0 or step == len(predicates) - 1:
+            break
+        if rows_out < rows_in * REDUCE_ROWS_RATIO:
+            # we only need the columns the rest of the predicates refer to
+            columns: set = set()
+            for later in evaluation_order[step + 1 :]:
+                _referenced_columns(predicates[later], subset.column_names, columns)
+            subset = subset.select(
+                [name for name in subset.column_names if name in columns]
+            ).filter(remaining)
+            mask = mask.filter(remaining)
+            remaining = remaining.to_numpy(zero_copy_only=False)
+            positions = (
+                numpy.flatnonzero(remaining)
+                if positions is None
+                else positions[remaining]
+            )
+
+    if positions is None:
+        return mask
+    if isinstance(mask, pyarrow.ChunkedArray):
+        mask = mask.combine_chunks()
+    # the rows which aren't in the subset were eliminated
+    in_subset = numpy.zeros(table.num_rows, dtype=bool)
+    in_subset[positions] = True
+    return compute.replace_with_mask(
+        pyarrow.array(numpy.zeros(table.num_rows, dtype=bool)),
+        pyarrow.array(in_subset),
+        mask,
+    )
+
+
+def _with_nulls(table: Table, predicate: tuple, mask):
+    """
+    A comparison (=, <>, <, > etc) is null (unknown) for the rows where one of the
+    columns being compared is null, whatever the mask says - numpy compares the
+    nulls as None or NaN, so e.g. <> would be true. Other conditions are unknown for
+    these rows unless the condition matched.
+
+    As with _in_list, IN and NOT IN a list containing a null are also unknown for
+    the rows which aren't one of the other values in the list.
+    """
+    mask = pyarrow.array(mask, type=pyarrow.bool_())
+    nulls = None
+    for operand in (predicate[0], predicate[2]):
+        if (
+            isinstance(operand, tuple)
+            and len(operand) == 2
+            and operand[1] == TOKEN_TYPES.IDENTIFIER
+        ):
+            column = table.column(operand[0])
+            if column.null_count > 0:
+                is_null = compute.is_null(column).combine_chunks()
+                nulls = is_null if nulls is None else compute.or_(nulls, is_null)
+    if (
+        predicate[1] in ("in", "not in")
+        and predicate[2][1] == TOKEN_TYPES.LIST
+        and None in predicate[2][0]
+    ):
+        unmatched = mask if predicate[1] == "not in" else compute.invert(mask)
+        nulls = unmatched if nulls is None else compute.or_(nulls, unmatched)
+    if nulls is None:
+        return mask
+    if predicate[1] in COMPARISON_OPERATORS:
+        unknown = nulls
+    else:
+        unknown = compute.and_not(nulls, mask)
+    return compute.if_else(unknown, pyarrow.scalar(None, pyarrow.bool_()), mask)
+
+
+def _in_list(table: Table, predicate: tuple):
+    """
+    IN and NOT IN a list of values, the values are looked up in a hash set built over
+    the array of values, rather than testing each row in Python.
+
+    x IN (...) is unknown (null) when x is null, or when x isn't in the list and the
+    list contains a null. Returns None if the values can't be compared natively.
+    """
+    left, operator, right = predicate
+    if (
+        operator not in ("in", "not in")
+        or len(left) != 2
+        or left[1] != TOKEN_TYPES.IDENTIFIER
+        or not isinstance(right[0], pyarrow.Array)
+    ):
+        return None
+
+    column = table.column(left[0])
+    values = right[0]
+    list_has_null = values.null_count > 0
+    if list_has_null:
+        values = values.drop_null()
+    try:
+        if values.type != column.type:
+            try:
+                values = values.cast(column.type)
+            except pyarrow.ArrowInvalid:
+                # e.g. an integer column and a list with fractional values
+                column = column.cast(values.type)
+        matches = compute.is_in(column, value_set=values)
+    except (pyarrow.ArrowInvalid, pyarrow.ArrowNotImplementedError):
+        return None
+
+    if isinstance(matches, pyarrow.ChunkedArray):
+        matches = matches.combine_chunks()
+    if column.null_count > 0 or list_has_null:
+        unknown = compute.is_null(column)
+        if isinstance(unknown, pyarrow.ChunkedArray):
+            unknown = unknown.combine_chunks()
+        if list_has_null:
+            unknown = compute.or_(unknown, compute.invert(matches))
+        matches = compute.if_else(
+            unknown, pyarrow.scalar(None, pyarrow.bool_()), matches
+        )
+    if operator == "not in":
+        return compute.invert(matches)
+    return matches
+
+
+def _match_any(table: Table, group: tuple):
+    """
+    LIKE, ILIKE and SEARCH conditions on the same column, ORed together, are matched
+    in a single pass of the column. Returns None if the column isn't a string column.
+    """
+    column, operator, patterns = group
+    if column[0] not in table.column_names:
+        return None
+    values = table.column(column[0]).combine_chunks()
+    if pyarrow.types.is_dictionary(values.type):
+        values = values.dictionary_decode()
+    if not (
+        pyarrow.types.is_string(values.type)
+        or pyarrow.types.is_large_string(values.type)
+    ):
+        return None
+    return string_patterns.match_any(values, operator, patterns[0])
+
+
+def _evaluate(predicate: Union[tuple, list], table: Table, orders: Dict = None):
     """
     Evaluate a table against a DNF selection.
 
     This is done by creating a mask for the values to return - we evaluate the page
     against a predicate (including resolving child predicates) and then AND or OR the
-    masks together to return the rows that match the predicate.
+    masks together to return the rows that match the predicate. The mask is null for
+    the rows where the predicate is unknown.
+
+    The orders are the learned orders of the AND lists in the predicate.
     """
+    if orders is None:
+        orders = {}
 
-    from opteryx.third_party.pyarrow_ops import ifilters
+    from opteryx.third_party.pyarrow_ops import filter_mask
 
     columns = Columns(table)
 
@@ -71,70 +345,40 @@ def _evaluate(predicate: Union[tuple, list], table: Table):
 
         # if we're pointlessly nested, break out
         if len(predicate) == 1:
-            return _evaluate(predicate=predicate[0], table=table)
+            return _evaluate(predicate=predicate[0], table=table, orders=orders)
+
+        # LIKE conditions on the same column ORed together
+        if len(predicate) == 3 and predicate[0] == "AnyPattern":
+            mask = _match_any(table, predicate[1])
+            if mask is not None:
+                return mask
+            return _evaluate(predicate=predicate[2], table=table, orders=orders)
 
         # handle IS and NOT statements
         if len(predicate) == 2 and predicate[0] == "Not":
-            # calculate the answer of the non-negated condition (positive)
-            positive_result = _evaluate(predicate=predicate[1], table=table)
-            # negate it by removing the values in the positive results from
-            # all of the possible values (mask)
-            mask = numpy.arange(table.num_rows, dtype=numpy.int32)
-            return numpy.setdiff1d(mask, positive_result, assume_unique=True)
+            # negating an unknown result is still unknown
+            return compute.invert(
+                _evaluate(predicate=predicate[1], table=table, orders=orders)
+            )
         if len(predicate) == 2 and predicate[0] in UNARY_OPERATIONS:
-            return UNARY_OPERATIONS[predicate[0]](table, predicate[1])
-
-        # this is a function in the selection
+            mask = UNARY_OPERATIONS[predicate[0]](table, predicate[1])
+            if isinstance(mask, pyarrow.ChunkedArray):
+                mask = mask.combine_chunks()
+            return mask
+
+        # this is a function in the selection, known functions have been replaced
+        # with the columns they are evaluated to, so this is an unknown function or
+        # one which has already been evaluated (e.g. an aggregate in the HAVING)
         if len(predicate) == 3 and isinstance(predicate[2], dict):
-            # The function has already been evaluated, so we can use the existing
-            # results
-            if predicate[0] in table.column_names:
-                predicate = (
-                    (predicate[0], TOKEN_TYPES.IDENTIFIER),
-                    "=",
-                    (True, TOKEN_TYPES.BOOLEAN),
-                )
-            # The function has not already been evaluated, so we need to do this.
-            # The evaluation SHOULD be done as part of the evaluation node, but
-            # presently it only evaluates in the SELECT clause.
-            else:
-                # TODO: push this to the evaluation node
-
-                function = predicate[2]
-
-                arg_list = []
-                # go through the arguments and build arrays of the values
-                for arg in function["args"]:
-                    if arg[1] == TOKEN_TYPES.IDENTIFIER:
-                        # get the column from the dataset
-                        mapped_column = columns.get_column_from_alias(
-                            arg[0], only_one=True
-                        )
-                        arg_list.append(table[mapped_column].to_numpy())
-                    else:
-                        # it's a literal, just add it
-                        arg_list.append(arg[0])
-
-                if len(arg_list) == 0:
-                    arg_list = (table.num_rows,)  # type: ignore
-
-                return_type, executor = FUNCTIONS[function["function"]]
-                calculated_values = executor(*arg_list)
-                if isinstance(calculated_values, (pyarrow.lib.StringScalar)):
-                    calculated_values = [[calculated_values.as_py()]]
-                if return_type:
-                    calculated_values = pyarrow.array(
-                        calculated_values, type=return_type
-                    )
-                table = pyarrow.Table.append_column(
-                    table, predicate[0], calculated_values
-                )
-
-                predicate = (
-                    (predicate[0], TOKEN_TYPES.IDENTIFIER),
-                    "=",
-                    (True, TOKEN_TYPES.BOOLEAN),
+            if predicate[0] not in table.column_names:
+                raise SqlError(
+                    f"Function not known or not supported - {predicate[2]['function']}"
                 )
+            predicate = (
+                (predicate[0], TOKEN_TYPES.IDENTIFIER),
+                "=",
+                (True, TOKEN_TYPES.BOOLEAN),
+            )
 
         if (
             len(predicate) == 3
@@ -156,10 +400,20 @@ def _evaluate(predicate: Union[tuple, list], table: Table):
             )
 
         if not isinstance(predicate[0], tuple):
-            return _evaluate(predicate[0], table)
+            return _evaluate(predicate[0], table, orders)
+
+        mask = _in_list(table, predicate)
+        if mask is not None:
+            return mask
+        if isinstance(predicate[2][0], pyarrow.Array):
+            predicate = (
+                predicate[0],
+                predicate[1],
+                (set(predicate[2][0].to_pylist()), TOKEN_TYPES.LIST),
+            )
 
         # filters from pyarrow_ops only filters on a single predicate
-        return ifilters(table, predicate)
+        return _with_nulls(table, predicate, filter_mask(table, predicate))
 
     # If we have a list, we're going to recurse and call ourselves with the items in
     # the list
@@ -168,19 +422,14 @@ def _evaluate(predicate: Union[tuple, list], table: Table):
         # We AND them together
         mask = None
         if all(isinstance(p, tuple) for p in predicate):
-            # default to all selected
-            mask = numpy.arange(table.num_rows, dtype=numpy.int32)
-            for part in predicate:
-                mask = intersect1d(mask, _evaluate(part, table))
-            return mask  # type:ignore
+            return _evaluate_conjunction(predicate, table, orders)
 
         # Are all of the entries lists?
         # We OR them together
         if all(isinstance(p, list) for p in predicate):
-            # default to none selected
-            mask = numpy.zeros(0, dtype=numpy.int32)
             for part in predicate:
-                mask = union1d(mask, _evaluate(part, table))  # type:ignore
+                part_mask = _evaluate(part, table, orders)
+                mask = part_mask if mask is None else compute.or_kleene(mask, part_mask)
             return mask  # type:ignore
 
         # if we're here the structure of the filter is wrong
@@ -205,9 +454,8 @@ def _evaluate_subqueries(predicate):
             SqlError("Subquery in WHERE clause - column not found")
         if len(table_result.columns) != 1:
             raise SqlError("Subquery in WHERE clause - returned more than one column")
-        value_list = table_result.column(0).to_numpy()
-        # performing IN with a set is much faster than numpy arrays
-        value_list = set(value_list)
+        # the values are looked up in a hash set built from the array
+        value_list = compute.unique(table_result.column(0).combine_chunks())
         return (value_list, TOKEN_TYPES.LIST)
     if isinstance(predicate, tuple):
         return tuple(_evaluate_subqueries(p) for p in predicate)
@@ -216,6 +464,43 @@ def _evaluate_subqueries(predicate):
     return predicate
 
 
+def _replace_functions(predicate, expressions: Expressions, operand: bool = False):
+    """
+    Replace the calls to known functions with references to the columns they are
+    evaluated to, adding the functions to the expressions. Functions which are whole
+    predicates, e.g. `WHERE SEARCH(name, 'a')`, are compared to True.
+    """
+    if isinstance(predicate, list):
+        return [_replace_functions(p, expressions) for p in predicate]
+    if not isinstance(predicate, tuple):
+        return predicate
+    if (
+        len(predicate) == 3
+        and isinstance(predicate[2], dict)
+        and predicate[2].get("function") in FUNCTIONS
+    ):
+        column = (
+            expressions.add(predicate[2], str(predicate[0])),
+            TOKEN_TYPES.IDENTIFIER,
+        )
+        if operand:
+            return column
+        return (column, "=", (True, TOKEN_TYPES.BOOLEAN))
+    if operand or (len(predicate) == 3 and predicate[0] == "AnyPattern"):
+        return predicate
+    if len(predicate) == 2 and predicate[0] == "Not":
+        return ("Not", _replace_functions(predicate[1], expressions))
+    if len(predicate) == 2 and predicate[0] in UNARY_OPERATIONS:
+        return (predicate[0], _replace_functions(predicate[1], expressions, True))
+    if len(predicate) == 3 and isinstance(predicate[1], str):
+        return (
+            _replace_functions(predicate[0], expressions, True),
+            predicate[1],
+            _replace_functions(predicate[2], expressions, True),
+        )
+    return tuple(_replace_functions(p, expressions) for p in predicate)
+
+
 def _map_columns(predicate, columns):
     """
     This rewrites the filters to refer to the internal column names.
@@ -235,23 +520,50 @@ def _map_columns(predicate, columns):
     return predicate
 
 
+def _unused_columns(page, columns, unused):
+    """
+    The columns in the page which are only known by names which aren't used after
+    the WHERE clause, at least one column is always kept so the rows can be counted.
+    """
+    drop = []
+    for column in page.column_names:
+        aliases = columns.get_aliases(column)
+        if aliases and all(alias.split(".")[-1] in unused for alias in aliases):
+            drop.append(column)
+    if len(drop) == page.num_columns:
+        drop = drop[1:]
+    return drop
+
+
 class SelectionNode(BasePlanNode):
     def __init__(
         self, directives: QueryDirectives, statistics: QueryStatistics, **config
     ):
         super().__init__(directives=directives, statistics=statistics)
-        self._filter = config.get("filter")
+        # the functions in the filter, evaluated before the filter is applied
+        self._expressions = Expressions()
+        self._filter = _replace_functions(config.get("filter"), self._expressions)
         self._unfurled_filter = None
         self._mapped_filter = None
+        # the names of the columns which aren't referenced after the WHERE clause
+        self._unused = set(config.get("unused") or [])
+        self._drop: List = []
+        self._columns = None
+        # the learned order of the predicates in the AND lists
+        self._orders: Dict = {}
 
     @property
     def config(self):  # pragma: no cover
         def _inner_config(predicate):
             if isinstance(predicate, tuple):
+                if len(predicate) == 3 and predicate[0] == "AnyPattern":
+                    return _inner_config(predicate[2])
                 if len(predicate) > 1 and predicate[1] == TOKEN_TYPES.IDENTIFIER:
                     return f"`{predicate[0]}`"
                 if len(predicate) > 1 and predicate[1] == TOKEN_TYPES.VARCHAR:
                     return f'"{predicate[0]}"'
+                if len(predicate) > 1 and isinstance(predicate[0], pyarrow.Array):
+                    return f"({', '.join(repr(v) for v in predicate[0].to_pylist())})"
                 if len(predicate) == 2:
                     if predicate[0] == "Not":
                         return f"NOT {_inner_config(predicate[1])}"
@@ -263,7 +575,19 @@ class SelectionNode(BasePlanNode):
                 return "[" + ",".join(_inner_config(p) for p in predicate) + "]"
             return f"{predicate}"
 
-        return _inner_config(self._filter)
+        # after execution (EXPLAIN ANALYZE), show the order the predicates were
+        # evaluated in and the fraction of the rows each kept
+        order = None
+        if isinstance(self._mapped_filter, list):
+            order = self._orders.get(id(self._mapped_filter))
+        if order is None:
+            return _inner_config(self._filter)
+        evaluated = []
+        for index in order.order():
+            selectivity = order.selectivity(index)
+            selectivity = "-" if selectivity is None else f"{selectivity:.1%}"
+            evaluated.append(f"{_inner_config(self._filter[index])} {selectivity}")
+        return "[" + ",".join(evaluated) + "]"
 
     @property
     def name(self):  # pragma: no cover
@@ -294,8 +618,25 @@ class SelectionNode(BasePlanNode):
                 if self._mapped_filter is None:
                     columns = Columns(page)
                     self._mapped_filter = _map_columns(self._unfurled_filter, columns)
+                    self._drop = _unused_columns(page, columns, self._unused)
+                    self._columns = columns
 
                 start_selection = time.time_ns()
-                mask = _evaluate(self._mapped_filter, page)
+                evaluated = page
+                if len(self._expressions) > 0:
+                    results = self._expressions.evaluate(page, Columns(page))
+                    for column_name, values in results.items():
+                        if column_name not in page.column_names:
+                            evaluated = evaluated.append_column(column_name, values)
+                mask = _evaluate(self._mapped_filter, evaluated, self._orders)
+                if isinstance(mask, pyarrow.ChunkedArray):
+                    mask = mask.combine_chunks()
+                elif not isinstance(mask, pyarrow.Array):
+                    mask = pyarrow.array(mask, type=pyarrow.bool_())
+                if self._drop:
+                    page = self._columns.apply(page.drop(self._drop))
+                # rows where the predicate is unknown (null) are not selected
+                if mask.true_count != page.num_rows:
+                    page = page.filter(mask, null_selection_behavior="drop")
                 self._statistics.time_selecting += time.time_ns() - start_selection
-                yield page.take(mask)
+                yield page
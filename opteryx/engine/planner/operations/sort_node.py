@@ -16,16 +16,33 @@ Sort Node
 This is a SQL Query Execution Plan Node.
 
 This node orders a dataset
+
+If the data being sorted exceeds the memory budget, it is sorted as an external
+sort - the data is sorted in runs which fit in memory, these are written to spill
+files on local disk and then merged, a batch from each run at a time.
+
+Large tables are sorted in parallel (see opteryx.utils.sorting).
 """
 from typing import Iterable, List
 
+import numpy
+import pyarrow
 from pyarrow import Table, concat_tables
 
+from opteryx import config
 from opteryx.engine.functions import FUNCTIONS
 from opteryx.engine.planner.operations.base_plan_node import BasePlanNode
+from opteryx.engine.planner.operations.evaluation_node import Expressions
 from opteryx.engine import QueryDirectives, QueryStatistics
 from opteryx.exceptions import SqlError
 from opteryx.utils.columns import Columns
+from opteryx.utils.sorting import sort_table
+from opteryx.utils.spill import SpillFiles
+
+# when the data exceeds this size, it is sorted in runs which are written to disk
+MAX_OPERATOR_MEMORY = config.MAX_OPERATOR_MEMORY
+# the number of rows in each of the batches the runs are written and read as
+RUN_BATCH_ROWS = 50000
 
 
 class SortNode(BasePlanNode):
@@ -35,6 +52,13 @@ class SortNode(BasePlanNode):
         super().__init__(directives=directives, statistics=statistics)
         self._order = config.get("order", [])
         self._mapped_order: List = []
+        self._runs = 0
+        self._added_columns: List[str] = []
+        # functions in the ORDER BY which may need to be evaluated
+        self._expressions = Expressions()
+        for column, _ in self._order:
+            if isinstance(column, dict) and column["function"] in FUNCTIONS:
+                self._expressions.add(column, column["alias"])
 
     @property
     def greedy(self):  # pragma: no cover
@@ -44,6 +68,11 @@ class SortNode(BasePlanNode):
     def config(self):  # pragma: no cover
         return ",".join([str(i) for i in self._order])
 
+    @property
+    def order(self):
+        """the (column, direction) pairs the data will be ordered by"""
+        return self._order
+
     @property
     def name(self):  # pragma: no cover
         return "Sort"
@@ -57,29 +86,129 @@ class SortNode(BasePlanNode):
         if isinstance(data_pages, Table):
             data_pages = (data_pages,)
 
-        data_pages = data_pages.execute()
-        data_pages = tuple(data_pages)
+        pages: List = []
+        buffered_bytes = 0
+        spill = None
+        for page in data_pages.execute():
+            pages.append(page)
+            buffered_bytes += page.nbytes
+            if buffered_bytes > MAX_OPERATOR_MEMORY:
+                if spill is None:
+                    spill = SpillFiles(prefix="opteryx-sort-")
+                self._write_run(pages, spill)
+                pages = []
+                buffered_bytes = 0
+
+        if spill is not None:
+            with spill:
+                self._write_run(pages, spill)
+                self._statistics.bytes_spilled += spill.bytes_written
+                yield from self._merge_runs(spill)
+            return
+
+        data_pages = tuple(pages)
 
         if len([page for page in data_pages if page.num_rows == 0]) > 0:
             yield data_pages[0]
             return
 
         table = concat_tables(data_pages)
+        table, added_columns = self._map_order(table)
+
+        table = sort_table(table, self._mapped_order)
+
+        if added_columns:
+            table = table.drop(added_columns)
+
+        yield table
+
+    def _write_run(self, pages, spill):
+        """sort the pages and write them to disk as a run"""
+        pages = [page for page in pages if page.num_rows > 0]
+        if len(pages) == 0:
+            return
+        table, self._added_columns = self._map_order(concat_tables(pages))
+        table = sort_table(table, self._mapped_order)
+        spill.write(self._runs, table, max_chunksize=RUN_BATCH_ROWS)
+        self._runs += 1
+        self._statistics.spills += 1
+
+    def _merge_runs(self, spill):
+        """
+        k-way merge the sorted runs, we hold one batch from each run. The last row
+        of each batch is the lowest the rest of that run can be, so once we've sorted
+        the batches together, every row up to the first of these last rows can be
+        emitted, the run which owned that row reads its next batch.
+        """
+        runs = [spill.stream(run) for run in range(self._runs)]
+        current = [next(run, None) for run in runs]
+        order = self._mapped_order + [("__run", "ascending"), ("__row", "ascending")]
+
+        while any(batch is not None for batch in current):
+            batches = []
+            for run, batch in enumerate(current):
+                if batch is not None:
+                    batches.append(
+                        batch.append_column(
+                            "__run",
+                            pyarrow.array(numpy.full(batch.num_rows, run)),
+                        ).append_column(
+                            "__row", pyarrow.array(numpy.arange(batch.num_rows))
+                        )
+                    )
+            merged = concat_tables(batches).sort_by(order)
+            run_ids = merged["__run"].to_numpy()
+            row_ids = merged["__row"].to_numpy()
+
+            # find the first row which is the last row of its batch
+            last_rows = numpy.array(
+                [-1 if batch is None else batch.num_rows - 1 for batch in current]
+            )
+            boundary = numpy.flatnonzero(row_ids == last_rows[run_ids])[0]
+
+            emitted = merged.slice(0, boundary + 1)
+            emitted_per_run = numpy.bincount(
+                run_ids[: boundary + 1], minlength=len(current)
+            )
+            for run, batch in enumerate(current):
+                if batch is None:
+                    continue
+                if emitted_per_run[run] == batch.num_rows:
+                    current[run] = next(runs[run], None)
+                else:
+                    current[run] = batch.slice(emitted_per_run[run])
+
+            emitted = emitted.drop(["__run", "__row"])
+            if self._added_columns:
+                emitted = emitted.drop(self._added_columns)
+            yield emitted
+
+    def _map_order(self, table):
+        """
+        Map the ORDER BY to the columns in the table, the first time this is called
+        the order is mapped, after that only the functions which aren't columns in
+        the table (e.g. RANDOM()) are evaluated.
+
+        Returns the table (with the evaluated functions added) and the columns which
+        were added, which need to be removed after sorting.
+        """
         columns = Columns(table)
-        need_to_remove_random = False
+        added_columns: List[str] = []
+        map_order = len(self._mapped_order) == 0
 
         for column, direction in self._order:
 
             # function references aere recorded as dictionaries
             if isinstance(column, dict):
 
-                # we only have special handling for RANDOM at the moment
-                if column["alias"] != "RANDOM()":
-                    if len(columns.get_column_from_alias(column["alias"])) == 0:
+                existing = columns.get_column_from_alias(column["alias"])
+                if len(existing) > 0 or column["alias"] not in self._expressions:
+                    if not map_order:
+                        continue
+                    if len(existing) == 0:
                         raise SqlError(
-                            "ORDER BY can only reference functions used in the SELECT clause, or RANDOM()"
+                            "ORDER BY can only reference functions used in the SELECT clause, or functions of the columns in the SELECT clause"
                         )
-
                     self._mapped_order.append(
                         (
                             columns.get_column_from_alias(
@@ -89,22 +218,26 @@ class SortNode(BasePlanNode):
                         )
                     )
                 else:
-                    # this currently only supports zero parameter functions
-                    return_type, executor = FUNCTIONS[column["function"]]
-                    calculated_values = executor(*[table.num_rows])
-
+                    # the function isn't in the SELECT, so we evaluate it, we add it to
+                    # sort, but it's not in the SELECT so we shouldn't return it
+                    calculated_values = self._expressions.evaluate(
+                        table, columns, [column["alias"]]
+                    )[column["alias"]]
                     table = Table.append_column(
                         table, column["alias"], calculated_values
                     )
-                    # we add it to sort, but it's not in the SELECT so we shouldn't return it
-                    need_to_remove_random = True
+                    added_columns.append(column["alias"])
 
-                    self._mapped_order.append(
-                        (
-                            column["alias"],
-                            direction,
+                    if map_order:
+                        self._mapped_order.append(
+                            (
+                                column["alias"],
+                                direction,
+                            )
                         )
-                    )
+
+            elif not map_order:
+                continue
 
             # we have an index rather than a column name, it's a natural number but the
             # list of column names is zero-based, so we subtract one
@@ -125,9 +258,4 @@ class SortNode(BasePlanNode):
                     )
                 )
 
-        table = table.sort_by(self._mapped_order)
-
-        if need_to_remove_random:
-            table = table.drop(["RANDOM()"])
-
-        yield table
+        return table, added_columns
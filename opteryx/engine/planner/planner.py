@@ -41,6 +41,7 @@ these are not supported by SqlOxide and so are in a different module which strip
 temporal aspects out of the query.
 """
 import datetime
+import itertools
 import numpy
 import pyarrow
 
@@ -72,6 +73,31 @@ OPERATOR_XLAT = {
     "PGRegexNotMatch": "!~",
 }
 
+# WHERE conditions which can be applied by the readers
+PUSHABLE_OPERATORS = {"=", ">", ">=", "<", "<=", "in"}
+PUSHABLE_LITERALS = {TOKEN_TYPES.NUMERIC, TOKEN_TYPES.VARCHAR, TOKEN_TYPES.BOOLEAN}
+
+
+def _identifiers(node, found: set = None) -> set:
+    """the names of the columns referenced in part of the AST, without qualifiers"""
+    if found is None:
+        found = set()
+    if isinstance(node, dict):
+        for key, value in node.items():
+            if key == "Identifier":
+                found.add(value["value"])
+            elif key == "CompoundIdentifier":
+                found.add(value[-1]["value"])
+            elif key == "Using":
+                # JOIN ... USING (column, ...)
+                found.update(v["value"] for v in value)
+            else:
+                _identifiers(value, found)
+    elif isinstance(node, list):
+        for value in node:
+            _identifiers(value, found)
+    return found
+
 
 class QueryPlanner(ExecutionTree):
     def __init__(self, statistics, cache=None):
@@ -167,6 +193,82 @@ class QueryPlanner(ExecutionTree):
                 return (None, TOKEN_TYPES.OTHER)
             return (value["Value"], TOKEN_TYPES.OTHER)
 
+    def _pattern_term(self, term):
+        """
+        If the term of an OR is a LIKE, ILIKE or SEARCH on a column, return the column,
+        the operator and the LIKE pattern, otherwise None.
+        """
+        if not (len(term) == 1 and isinstance(term[0], tuple) and len(term[0]) == 3):
+            return None
+        left, operator, right = term[0]
+        if (
+            operator in ("like", "ilike")
+            and isinstance(left, tuple)
+            and len(left) == 2
+            and left[1] == TOKEN_TYPES.IDENTIFIER
+            and right[1] == TOKEN_TYPES.VARCHAR
+        ):
+            return left, operator, right[0]
+        if (
+            operator == TOKEN_TYPES.IDENTIFIER
+            and isinstance(right, dict)
+            and right["function"] == "SEARCH"
+            and len(right["args"]) == 2
+            and right["args"][0][1] == TOKEN_TYPES.IDENTIFIER
+            and right["args"][1][1] == TOKEN_TYPES.VARCHAR
+        ):
+            # SEARCH on a string is a case insensitive substring match
+            value = right["args"][1][0]
+            for character in ("\\", "%", "_"):
+                value = value.replace(character, "\\" + character)
+            return right["args"][0][:2], "ilike", f"%{value}%"
+        return None
+
+    def _combine_or(self, left, right):
+        """
+        OR two conditions, chains of ORs are combined into a single list.
+
+        LIKE, ILIKE and SEARCH conditions on the same column are grouped, so they can
+        be matched in a single pass of the column. The group is an ("AnyPattern",
+        (column, operator, patterns), terms) tuple, the terms are the original
+        conditions, which are evaluated when the group can't be matched in one pass
+        (e.g. SEARCH on a list column).
+        """
+        terms = []
+        for side in (left, right):
+            if isinstance(side, tuple) and len(side) == 3 and side[0] == "AnyPattern":
+                side = side[2]
+            if isinstance(side, list) and all(isinstance(p, list) for p in side):
+                terms.extend(side)
+            else:
+                terms.append([side])
+
+        groups: dict = {}
+        for term in terms:
+            pattern = self._pattern_term(term)
+            if pattern is not None:
+                groups.setdefault(pattern[:2], []).append((term, pattern[2]))
+
+        combined = []
+        for term in terms:
+            pattern = self._pattern_term(term)
+            group = None if pattern is None else groups.get(pattern[:2])
+            if group is None or len(group) < 2:
+                combined.append(term)
+            elif group[0][0] is term:
+                column, operator = pattern[:2]
+                patterns = tuple(pattern for _, pattern in group)
+                grouped = (
+                    "AnyPattern",
+                    (column, operator, (patterns, TOKEN_TYPES.LIST)),
+                    [term for term, _ in group],
+                )
+                combined.append([grouped])
+
+        if len(combined) == 1:
+            return combined[0][0]
+        return combined
+
     def _build_dnf_filters(self, filters):
 
         # None is None
@@ -202,7 +304,7 @@ class QueryPlanner(ExecutionTree):
                     return right
                 return [left, right]
             if operator in ("Or"):
-                return [[left], [right]]
+                return self._combine_or(left, right)
             return (left, OPERATOR_XLAT[operator], right)
         if "UnaryOp" in filters:
             if filters["UnaryOp"]["op"] == "Not":
@@ -239,10 +341,14 @@ class QueryPlanner(ExecutionTree):
             return (try_unary_filter, right)
         if "InList" in filters:
             left = self._build_dnf_filters(filters["InList"]["expr"])
-            right = (
-                {self._build_dnf_filters(v)[0] for v in filters["InList"]["list"]},
-                TOKEN_TYPES.LIST,
-            )
+            values = {self._build_dnf_filters(v)[0] for v in filters["InList"]["list"]}
+            try:
+                # the values are built into an array once, the selection looks the
+                # values up in a hash set built from the array
+                values = pyarrow.array(list(values))
+            except (pyarrow.ArrowInvalid, pyarrow.ArrowTypeError):
+                pass
+            right = (values, TOKEN_TYPES.LIST)
             operator = "not in" if filters["InList"]["negated"] else "in"
             return (left, operator, right)
         if "Function" in filters:
@@ -463,7 +569,12 @@ class QueryPlanner(ExecutionTree):
                     ]
                     if is_function(func):
                         return {"function": func, "args": args, "alias": alias}
-                    return {"aggregate": func, "args": args, "alias": alias}
+                    return {
+                        "aggregate": func,
+                        "args": args,
+                        "alias": alias,
+                        "distinct": function["Function"].get("distinct", False),
+                    }
                 if "BinaryOp" in function:
                     raise NotImplementedError(
                         "Operations in the SELECT clause are not supported"
@@ -585,7 +696,24 @@ class QueryPlanner(ExecutionTree):
             )
 
     def _extract_distinct(self, ast):
-        return ast[0]["Query"]["body"]["Select"]["distinct"]
+        """
+        Returns if the SELECT is DISTINCT and, for DISTINCT ON, the columns the
+        distinction is on
+        """
+        distinct = ast[0]["Query"]["body"]["Select"]["distinct"]
+        if isinstance(distinct, dict) and "On" in distinct:
+            columns = []
+            for column in distinct["On"]:
+                if "Identifier" in column:
+                    columns.append(column["Identifier"]["value"])
+                elif "CompoundIdentifier" in column:
+                    columns.append(
+                        ".".join([p["value"] for p in column["CompoundIdentifier"]])
+                    )
+                else:
+                    raise SqlError("DISTINCT ON can only reference columns.")
+            return True, columns
+        return bool(distinct), None
 
     def _extract_limit(self, ast):
         limit = ast[0]["Query"].get("limit")
@@ -599,6 +727,130 @@ class QueryPlanner(ExecutionTree):
             return int(offset["value"]["Value"]["Number"][0])
         return None
 
+    def _extract_referenced_columns(self, ast):
+        """
+        The names of the columns referenced anywhere in the query (SELECT, WHERE,
+        GROUP BY, HAVING, ORDER BY and JOIN), so the readers only need to decode these
+        columns. Returns None if the query selects all of the columns of any of the
+        relations (SELECT * or SELECT t.*).
+
+        Qualified names are reduced to the column name, and the names may include
+        aliases and columns from other relations, the readers ignore names which
+        aren't in the file they're reading.
+        """
+        select = ast[0]["Query"]["body"]["Select"]
+        if any(
+            "Wildcard" in item or "QualifiedWildcard" in item
+            for item in select["projection"]
+        ):
+            return None
+
+        referenced = _identifiers(ast[0]["Query"])
+        if len(referenced) == 0:
+            return None
+        return referenced
+
+    def _extract_unused_columns(self, ast):
+        """
+        The names of the columns referenced in the WHERE clause which aren't
+        referenced after it (in the SELECT, GROUP BY, HAVING or ORDER BY), these
+        columns aren't needed once the rows have been selected. The JOINs are before
+        the WHERE clause, so the columns only used to join aren't needed either.
+        """
+        select = ast[0]["Query"]["body"]["Select"]
+        if select["selection"] is None or any(
+            "Wildcard" in item or "QualifiedWildcard" in item
+            for item in select["projection"]
+        ):
+            return None
+
+        remainder = {
+            **ast[0]["Query"],
+            "body": {
+                "Select": {**select, "selection": None, "from": []},
+            },
+        }
+        return _identifiers(select["selection"]) - _identifiers(remainder)
+
+    def _extract_pushed_predicates(self, ast, dataset, mode):
+        """
+        Simple conditions from the WHERE clause the reader can apply while reading
+        (e.g. to skip Parquet row groups). Only conditions which are ANDed with the
+        rest of the WHERE clause are pushed, and the WHERE clause is still evaluated
+        in full. Returns a list of (column, operator, value) tuples, or None.
+        """
+        if mode != "Blob" or not isinstance(dataset, str):
+            return None
+        select = ast[0]["Query"]["body"]["Select"]
+        if len(select["from"]) != 1 or len(select["from"][0]["joins"]) != 0:
+            return None
+
+        def _column(operand):
+            if (
+                isinstance(operand, tuple)
+                and len(operand) == 2
+                and operand[1] == TOKEN_TYPES.IDENTIFIER
+            ):
+                # there's only one relation, so we can drop the qualifier
+                return operand[0].split(".")[-1]
+            return None
+
+        def _inner(predicate):
+            # if we're pointlessly nested, break out
+            while isinstance(predicate, tuple) and len(predicate) == 1:
+                predicate = predicate[0]
+            if isinstance(predicate, list):
+                if all(isinstance(p, tuple) for p in predicate):
+                    return [pushed for p in predicate for pushed in _inner(p)]
+                return []
+            if not isinstance(predicate, tuple):
+                return []
+            if len(predicate) == 2 and predicate[0] in ("IsNull", "IsNotNull"):
+                column = _column(predicate[1])
+                return [(column, predicate[0], None)] if column else []
+            if (
+                len(predicate) == 3
+                and isinstance(predicate[1], str)
+                and predicate[1] in PUSHABLE_OPERATORS
+            ):
+                column = _column(predicate[0])
+                value = predicate[2]
+                if column is None or not isinstance(value, tuple) or len(value) != 2:
+                    return []
+                if predicate[1] == "in" and isinstance(value[0], pyarrow.Array):
+                    return [(column, "in", value[0])]
+                if value[1] in PUSHABLE_LITERALS and value[0] is not None:
+                    return [(column, predicate[1], value[0])]
+            return []
+
+        pushed = _inner(self._extract_selection(ast))
+        if len(pushed) == 0:
+            return None
+        return pushed
+
+    def _extract_scan_limit(self, ast, dataset, mode):
+        """
+        The LIMIT and OFFSET can be applied by the reader when there's a single
+        dataset and nothing between the reader and the LIMIT changes which rows are
+        returned. Returns the (offset, limit) for the reader, or None.
+        """
+        limit = self._extract_limit(ast)
+        if limit is None or mode != "Blob" or not isinstance(dataset, str):
+            return None
+        select = ast[0]["Query"]["body"]["Select"]
+        if len(select["from"]) != 1 or len(select["from"][0]["joins"]) != 0:
+            return None
+        if (
+            self._extract_selection(ast)
+            or self._extract_groups(ast)[0]
+            or self._extract_having(ast)
+            or self._extract_distinct(ast)[0]
+            or self._extract_order(ast)
+            or any("aggregate" in a for a in self._extract_projections(ast))
+        ):
+            return None
+        return self._extract_offset(ast) or 0, limit
+
     def _extract_order(self, ast):
         order = ast[0]["Query"].get("order_by")
         if order is not None:
@@ -614,15 +866,21 @@ class QueryPlanner(ExecutionTree):
                 if "Function" in column:
                     func = column["Function"]["name"][0]["value"].upper()
                     args = [
-                        self._build_dnf_filters(a)[0]
-                        for a in column["Function"]["args"]
+                        self._build_dnf_filters(a) for a in column["Function"]["args"]
                     ]
-                    args = ["*" if i == "Wildcard" else i for i in args]
-                    args = [
-                        ((f"({','.join(a[0])})",) if isinstance(a[0], list) else a)
+                    names = [
+                        (
+                            "*"
+                            if a[1] == TOKEN_TYPES.WILDCARD
+                            else (
+                                f"({','.join(a[0])})"
+                                if isinstance(a[0], list)
+                                else str(a[0])
+                            )
+                        )
                         for a in args
                     ]
-                    alias = f"{func.upper()}({','.join([str(a[0]) for a in args])})"
+                    alias = f"{func.upper()}({','.join(names)})"
                     column = {"function": func, "args": args, "alias": alias}
                 if "Value" in column:
                     column = int(column["Value"]["Number"][0])
@@ -635,6 +893,12 @@ class QueryPlanner(ExecutionTree):
             return orders
 
     def _extract_groups(self, ast):
+        """
+        Returns the columns being grouped by, and if the GROUP BY has ROLLUP, CUBE or
+        GROUPING SETS, the list of groupings, e.g. ROLLUP(a, b) is (a, b), (a), ().
+        Other GROUP BY items are included in every grouping.
+        """
+
         def _inner(element):
             if element:
                 if "Identifier" in element:
@@ -665,7 +929,75 @@ class QueryPlanner(ExecutionTree):
                     return int(element["Value"]["Number"][0])
 
         groups = ast[0]["Query"]["body"]["Select"]["group_by"]
-        return [_inner(g) for g in groups]
+        if not any(
+            "Rollup" in g or "Cube" in g or "GroupingSets" in g
+            for g in groups
+            if isinstance(g, dict)
+        ):
+            return [_inner(g) for g in groups], None
+
+        grouping_sets: list = [[]]
+        for group in groups:
+            if "Rollup" in group:
+                items = [[_inner(e) for e in item] for item in group["Rollup"]]
+                sets = [sum(items[:i], []) for i in range(len(items), -1, -1)]
+            elif "Cube" in group:
+                items = [[_inner(e) for e in item] for item in group["Cube"]]
+                sets = [
+                    sum(combination, [])
+                    for size in range(len(items), -1, -1)
+                    for combination in itertools.combinations(items, size)
+                ]
+            elif "GroupingSets" in group:
+                sets = [[_inner(e) for e in item] for item in group["GroupingSets"]]
+            else:
+                sets = [[_inner(group)]]
+            grouping_sets = [a + b for a in grouping_sets for b in sets]
+
+        columns: list = []
+        for grouping in grouping_sets:
+            columns.extend(g for g in grouping if g not in columns)
+        return columns, grouping_sets
+
+    def _extract_evaluations(self, ast, projection):
+        """
+        The functions which aren't in the SELECT clause which need to be evaluated
+        before the aggregation, these are the functions in the GROUP BY clause and
+        the functions which are aggregated, e.g. MAX(LENGTH(name)).
+        """
+
+        def _elements(groups):
+            for group in groups:
+                sets = None
+                if isinstance(group, dict):
+                    sets = group.get(
+                        "Rollup", group.get("Cube", group.get("GroupingSets"))
+                    )
+                if sets is None:
+                    yield group
+                else:
+                    for items in sets:
+                        yield from items
+
+        functions = []
+        groups = ast[0]["Query"]["body"]["Select"]["group_by"]
+        for element in _elements(groups):
+            if isinstance(element, dict) and "Function" in element:
+                function = self._build_dnf_filters(element)[2]
+                if is_function(function["function"]):
+                    functions.append(function)
+
+        for attribute in projection:
+            if isinstance(attribute, dict) and "aggregate" in attribute:
+                for arg in attribute["args"]:
+                    if (
+                        len(arg) == 3
+                        and isinstance(arg[2], dict)
+                        and is_function(arg[2]["function"])
+                    ):
+                        functions.append(arg[2])
+
+        return functions
 
     def _extract_having(self, ast):
         having = ast[0]["Query"]["body"]["Select"]["having"]
@@ -674,12 +1006,52 @@ class QueryPlanner(ExecutionTree):
     def _extract_directives(self, ast):
         return QueryDirectives()
 
+    def _ordered_by(self, dataset):
+        """
+        If the relation is a subquery which ends with an ORDER BY, return the columns
+        the data is ordered by. The nodes which can be after the sort in a plan
+        (projection, distinct, limit and offset) don't change the order.
+        """
+        if not isinstance(dataset, QueryPlanner):
+            return []
+        exit_points = dataset.get_exit_points()
+        if len(exit_points) != 1:
+            return []
+        node = exit_points[0]
+        while True:
+            operator = dataset.get_operator(node)
+            if isinstance(operator, operations.SortNode):
+                # we can only match names, so stop at positions and functions
+                columns = []
+                for column, _ in operator.order:
+                    if not isinstance(column, str):
+                        break
+                    columns.append(column)
+                return columns
+            if not isinstance(
+                operator,
+                (
+                    operations.ProjectionNode,
+                    operations.DistinctNode,
+                    operations.LimitNode,
+                    operations.OffsetNode,
+                ),
+            ):
+                return []
+            producers = dataset.get_incoming_links(node)
+            if len(producers) != 1:
+                return []
+            node = producers[0][0]
+
     def _explain_planner(self, ast, statistics):
         directives = self._extract_directives(ast)
         explain_plan = self.copy()
         explain_plan.create_plan(ast=[ast[0]["Explain"]["statement"]])
         explain_node = operations.ExplainNode(
-            directives, statistics, query_plan=explain_plan
+            directives,
+            statistics,
+            query_plan=explain_plan,
+            analyze=ast[0]["Explain"].get("analyze", False),
         )
         self.add_operator("explain", explain_node)
 
@@ -770,6 +1142,9 @@ class QueryPlanner(ExecutionTree):
             reader = get_adapter(dataset)
             mode = reader.__mode__
 
+        _scan_limit = self._extract_scan_limit(ast, dataset, mode)
+        _referenced_columns = self._extract_referenced_columns(ast)
+        _pushed_predicates = self._extract_pushed_predicates(ast, dataset, mode)
         self.add_operator(
             "from",
             operations.reader_factory(mode)(
@@ -782,6 +1157,9 @@ class QueryPlanner(ExecutionTree):
                 start_date=self.start_date,
                 end_date=self.end_date,
                 hints=hints,
+                scan_limit=_scan_limit,
+                projection=_referenced_columns,
+                selection=_pushed_predicates,
             ),
         )
         last_node = "from"
@@ -820,6 +1198,7 @@ class QueryPlanner(ExecutionTree):
                         start_date=self.start_date,
                         end_date=self.end_date,
                         hints=right[3],
+                        projection=_referenced_columns,
                     )
 
                 join_node = operations.join_factory(join_type)
@@ -844,11 +1223,15 @@ class QueryPlanner(ExecutionTree):
                 last_node = f"join-{join_id}"
 
         _projection = self._extract_projections(ast)
-        if any("function" in a for a in _projection):
+        _evaluations = self._extract_evaluations(ast, _projection)
+        if any("function" in a for a in _projection) or _evaluations:
             self.add_operator(
                 "eval",
                 operations.EvaluationNode(
-                    directives, statistics, projection=_projection
+                    directives,
+                    statistics,
+                    projection=_projection,
+                    functions=_evaluations,
                 ),
             )
             self.link_operators(last_node, "eval")
@@ -858,12 +1241,17 @@ class QueryPlanner(ExecutionTree):
         if _selection:
             self.add_operator(
                 "where",
-                operations.SelectionNode(directives, statistics, filter=_selection),
+                operations.SelectionNode(
+                    directives,
+                    statistics,
+                    filter=_selection,
+                    unused=self._extract_unused_columns(ast),
+                ),
             )
             self.link_operators(last_node, "where")
             last_node = "where"
 
-        _groups = self._extract_groups(ast)
+        _groups, _grouping_sets = self._extract_groups(ast)
         if _groups or any(["aggregate" in a for a in _projection]):
             _aggregates = _projection.copy()
             if isinstance(_aggregates, dict):
@@ -876,10 +1264,23 @@ class QueryPlanner(ExecutionTree):
                         "alias": None,
                     }
                 )
+            # if the data is already ordered by the groups, we can aggregate one
+            # group at a time, the order needs to start with the groups
+            _order = self._ordered_by(dataset) if len(_joins) == 0 else []
+            _ordered = (
+                len(_groups) > 0
+                and _grouping_sets is None
+                and set(_groups) == set(_order[: len(_groups)])
+            )
             self.add_operator(
                 "agg",
                 operations.AggregateNode(
-                    directives, statistics, aggregates=_aggregates, groups=_groups
+                    directives,
+                    statistics,
+                    aggregates=_aggregates,
+                    groups=_groups,
+                    grouping_sets=_grouping_sets,
+                    ordered=_ordered,
                 ),
             )
             self.link_operators(last_node, "agg")
@@ -904,31 +1305,44 @@ class QueryPlanner(ExecutionTree):
             self.link_operators(last_node, "select")
             last_node = "select"
 
-        _distinct = self._extract_distinct(ast)
+        _distinct, _distinct_on = self._extract_distinct(ast)
         if _distinct:
             self.add_operator(
-                "distinct", operations.DistinctNode(directives, statistics)
+                "distinct",
+                operations.DistinctNode(directives, statistics, on=_distinct_on),
             )
             self.link_operators(last_node, "distinct")
             last_node = "distinct"
 
         _order = self._extract_order(ast)
-        if _order:
+        _offset = self._extract_offset(ast)
+        _limit = self._extract_limit(ast)
+        if _order and _limit is not None:
+            # if we only need the first K rows, we only need to keep K rows while
+            # sorting, the OFFSET and LIMIT are still applied after the sort
+            self.add_operator(
+                "order",
+                operations.HeapSortNode(
+                    directives, statistics, order=_order, limit=_limit + (_offset or 0)
+                ),
+            )
+            self.link_operators(last_node, "order")
+            last_node = "order"
+        elif _order:
             self.add_operator(
                 "order", operations.SortNode(directives, statistics, order=_order)
             )
             self.link_operators(last_node, "order")
             last_node = "order"
 
-        _offset = self._extract_offset(ast)
-        if _offset:
+        # if the reader applied the OFFSET, we don't apply it again
+        if _offset and _scan_limit is None:
             self.add_operator(
                 "offset", operations.OffsetNode(directives, statistics, offset=_offset)
             )
             self.link_operators(last_node, "offset")
             last_node = "offset"
 
-        _limit = self._extract_limit(ast)
         # 0 limit is valid
         if _limit is not None:
             self.add_operator(
@@ -26,6 +26,8 @@ class QueryStatistics:
         self.bytes_read_data: int = 0
         self.bytes_processed_data: int = 0
         self.count_blobs_ignored_frames: int = 0
+        self.count_blobs_read_from_metadata: int = 0
+        self.count_blobs_pruned: int = 0
         self.rows_read: int = 0
 
         self.read_errors: int = 0
@@ -61,6 +63,9 @@ class QueryStatistics:
         self.page_splits: int = 0
         self.page_merges: int = 0
 
+        self.spills: int = 0
+        self.bytes_spilled: int = 0
+
     def _ns_to_s(self, nano_seconds):
         """convert elapsed ns to s"""
         if nano_seconds == 0:
@@ -89,6 +94,8 @@ class QueryStatistics:
             "count_data_blobs_read": self.count_data_blobs_read,
             "count_non_data_blobs_read": self.count_non_data_blobs_read,
             "count_blobs_ignored_frames": self.count_blobs_ignored_frames,
+            "count_blobs_read_from_metadata": self.count_blobs_read_from_metadata,
+            "count_blobs_pruned": self.count_blobs_pruned,
             "count_unknown_blob_type_found": self.count_unknown_blob_type_found,
             "count_control_blobs_found": self.count_control_blobs_found,
             "read_errors": self.read_errors,
@@ -113,4 +120,6 @@ class QueryStatistics:
             "document_pages": self.document_pages,
             "page_splits": self.page_splits,
             "page_merges": self.page_merges,
+            "spills": self.spills,
+            "bytes_spilled": self.bytes_spilled,
         }
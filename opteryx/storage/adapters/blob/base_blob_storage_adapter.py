@@ -74,3 +74,11 @@ class BaseBlobStorageAdapter(abc.ABC):
         Return a filelike object
         """
         raise NotImplementedError("read_blob not implemented")
+
+    def open_blob(self, blob_name: str):
+        """
+        Return a seekable filelike object for when only part of the blob is needed
+        (e.g. the footer), adapters which can read part of a blob should override
+        this, the default is to read the entire blob.
+        """
+        return self.read_blob(blob_name)
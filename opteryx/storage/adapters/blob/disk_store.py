@@ -22,6 +22,10 @@ class DiskStorage(BaseBlobStorageAdapter):
             # wrap in a BytesIO so we can close the file
             return io.BytesIO(blob.read())
 
+    def open_blob(self, blob_name):
+        # the caller is responsible for closing the file
+        return open(blob_name, "rb")
+
     def get_blob_list(self, partition):
         import glob
 
@@ -12,56 +12,330 @@
 
 """
 Decode files from a raw binary format to a PyArrow Table.
+
+The decoders can be given a projection, the columns the query needs, formats which
+store data by column only decode those columns. The projection may include names
+which aren't columns in the file, these are ignored.
+
+The decoders can be given a selection, an expression of the conditions from the
+WHERE clause which are simple enough to be pushed to the decoders. Parquet skips the
+row groups which the statistics show can't match, and the rows from Parquet and ORC
+files are filtered as they are read. The Selection Node still applies the full
+WHERE clause, so decoders for other formats ignore the selection.
+
+The decoders can be given an offset and a limit, when the reader only needs some of
+the rows (e.g. for SELECT * ... LIMIT 10), they stop decoding once they have the rows
+they need, rather than decoding the entire file.
 """
+import pyarrow
+
+# the largest batch read when we're only reading some of the rows
+DECODE_BATCH_ROWS = 65536
+# errors applying a selection, we read without the selection when these happen
+_FILTER_ERRORS = (
+    pyarrow.ArrowInvalid,
+    pyarrow.ArrowNotImplementedError,
+    pyarrow.ArrowTypeError,
+)
 
 
-def zstd_decoder(stream, projection):
+def _project(projection, names):
+    """
+    The columns in the file to read, in the order they are in the file. If none of
+    the columns in the projection are in the file, all of the columns are read.
+    """
+    if projection is None:
+        return None
+    projection = set(projection)
+    columns = [name for name in names if name in projection]
+    return columns or None
+
+
+def zstd_decoder(stream, projection, offset=0, limit=None, selection=None):
     """
     Read zstandard compressed JSONL files
     """
+    import io
     import zstandard
 
     with zstandard.open(stream, "rb") as file:
-        return jsonl_decoder(file, projection)
+        if limit is not None:
+            # the decompressor doesn't read lines, which we need to stop reading
+            # once we have enough rows
+            file = io.BufferedReader(file)
+        return jsonl_decoder(file, projection, offset, limit)
 
 
-def parquet_decoder(stream, projection):
+def parquet_decoder(stream, projection, offset=0, limit=None, selection=None):
     """
     Read parquet formatted files
+
+    If a limit is given, row groups before the offset aren't read and decoding
+    stops once we have enough rows.
     """
     import pyarrow.parquet as pq
 
-    table = pq.read_table(stream, columns=projection)
-    return table
+    if limit is None and projection is None and selection is None:
+        table = pq.read_table(stream)
+        return table
+
+    parquet_file = pq.ParquetFile(stream)
+    projection = _project(projection, parquet_file.schema_arrow.names)
+    if selection is not None:
+        # row groups are skipped using their statistics, and the rows filtered as
+        # they're read
+        try:
+            stream.seek(0)
+            table = pq.read_table(stream, columns=projection, filters=selection)
+            return table
+        except _FILTER_ERRORS:
+            # e.g. the types in the condition don't match the column, we leave the
+            # Selection Node to report the error
+            pass
+    if limit is None:
+        table = parquet_file.read(columns=projection)
+        return table
+
+    metadata = parquet_file.metadata
+
+    # skip the row groups which are all in the offset
+    row_groups = []
+    for row_group in range(metadata.num_row_groups):
+        row_count = metadata.row_group(row_group).num_rows
+        if not row_groups and offset >= row_count:
+            offset -= row_count
+            continue
+        row_groups.append(row_group)
 
+    batches = []
+    rows = 0
+    if limit > 0 and row_groups:
+        for batch in parquet_file.iter_batches(
+            batch_size=min(offset + limit, DECODE_BATCH_ROWS),
+            row_groups=row_groups,
+            columns=projection,
+        ):
+            batches.append(batch)
+            rows += batch.num_rows
+            if rows >= offset + limit:
+                break
+    return _slice_batches(parquet_file.schema_arrow, batches, projection, offset, limit)
 
-def orc_decoder(stream, projection):
+
+def orc_decoder(stream, projection, offset=0, limit=None, selection=None):
     """
     Read orc formatted files
+
+    If a limit is given, stripes are read until we have enough rows.
     """
     import pyarrow.orc as orc
 
     orc_file = orc.ORCFile(stream)
-    table = orc_file.read(columns=projection)
-    return table
+    projection = _project(projection, orc_file.schema.names)
+    if selection is not None:
+        # pyarrow doesn't expose the stripe statistics, so we can't skip stripes,
+        # but we only keep the matching rows of each stripe as it is read
+        try:
+            return _filter_stripes(orc_file, projection, selection)
+        except _FILTER_ERRORS:
+            pass
+    if limit is None:
+        table = orc_file.read(columns=projection)
+        return table
+
+    batches = []
+    rows = 0
+    for stripe in range(orc_file.nstripes):
+        if rows >= offset + limit:
+            break
+        batch = orc_file.read_stripe(stripe, columns=projection)
+        batches.append(batch)
+        rows += batch.num_rows
+    return _slice_batches(orc_file.schema, batches, projection, offset, limit)
 
 
-def jsonl_decoder(stream, projection):
+def jsonl_decoder(stream, projection, offset=0, limit=None, selection=None):
 
     import pyarrow.json
 
+    if limit is not None:
+        # only parse the lines we need
+        import io
+
+        lines = []
+        first_line = None
+        for line in stream:
+            if not line.strip():
+                continue
+            if first_line is None:
+                first_line = line
+            if offset > 0:
+                offset -= 1
+                continue
+            if len(lines) == limit:
+                break
+            lines.append(line if line.endswith(b"\n") else line + b"\n")
+        if len(lines) == 0:
+            if first_line is None:
+                return pyarrow.table({})
+            # we need a row to know the schema
+            table = jsonl_decoder(io.BytesIO(first_line), projection)
+            return table.slice(0, 0)
+        stream = io.BytesIO(b"".join(lines))
+
     table = pyarrow.json.read_json(stream)
 
     # the read doesn't support projection, so do it now
+    projection = _project(projection, table.column_names)
     if projection:
         table = table.select(projection)
 
     return table
 
 
-def arrow_decoder(stream, projection):
+def arrow_decoder(stream, projection, offset=0, limit=None, selection=None):
 
     import pyarrow.feather as pf
+    import pyarrow.ipc
 
-    table = pf.read_table(stream, columns=projection)
-    return table
+    try:
+        reader = pyarrow.ipc.open_file(stream)
+    except pyarrow.ArrowInvalid:
+        # feather v1 files aren't arrow ipc files, these are read in full
+        stream.seek(0)
+        table = pf.read_table(stream)
+        projection = _project(projection, table.column_names)
+        if projection:
+            table = table.select(projection)
+        if limit is not None:
+            table = table.slice(offset, limit)
+        return table
+
+    projection = _project(projection, reader.schema.names)
+    if limit is None:
+        stream.seek(0)
+        table = pf.read_table(stream, columns=projection)
+        return table
+
+    batches = []
+    rows = 0
+    for batch_index in range(reader.num_record_batches):
+        if rows >= offset + limit:
+            break
+        batch = reader.get_batch(batch_index)
+        batches.append(batch)
+        rows += batch.num_rows
+    return _slice_batches(reader.schema, batches, projection, offset, limit)
+
+
+def _filter_stripes(orc_file, projection, selection):
+    """
+    read the stripes one at a time, keeping the rows which match the selection, the
+    projection includes the columns referenced in the selection
+    """
+    from pyarrow import Table, concat_tables
+
+    tables = [
+        Table.from_batches([orc_file.read_stripe(stripe, columns=projection)]).filter(
+            selection
+        )
+        for stripe in range(orc_file.nstripes)
+    ]
+    if len(tables) == 0:
+        return orc_file.read(columns=projection)
+    return concat_tables(tables)
+
+
+def _slice_batches(schema, batches, projection, offset, limit):
+    """build a table from the batches, and return the rows in the window"""
+    from pyarrow import Table
+
+    if batches:
+        table = Table.from_batches(batches)
+    else:
+        table = schema.empty_table()
+    if projection and table.column_names != projection:
+        table = table.select(projection)
+    return table.slice(offset, limit)
+
+
+def parquet_statistics(stream):
+    """
+    Read the row count and the column statistics from the footer of a parquet file,
+    only the footer is read, the data pages aren't decoded.
+
+    Min/max values are only collected for numeric, boolean and temporal columns,
+    string statistics may be truncated by the writer so can't be relied on, only the
+    null counts are collected for other columns.
+    """
+    import pyarrow.parquet as pq
+    from pyarrow import types
+
+    parquet_file = pq.ParquetFile(stream)
+    metadata = parquet_file.metadata
+    schema = parquet_file.schema_arrow
+
+    columns: dict = {}
+    without_min_max = set()
+    for field in schema:
+        if types.is_nested(field.type):
+            continue
+        if not (
+            types.is_integer(field.type)
+            or types.is_floating(field.type)
+            or types.is_boolean(field.type)
+            or types.is_temporal(field.type)
+        ):
+            without_min_max.add(field.name)
+        columns[field.name] = {"type": field.type, "null_count": 0}
+
+    for row_group_index in range(metadata.num_row_groups):
+        row_group = metadata.row_group(row_group_index)
+        for column_index in range(row_group.num_columns):
+            column = row_group.column(column_index)
+            summary = columns.get(column.path_in_schema)
+            if summary is None:
+                continue
+            statistics = column.statistics
+            if statistics is None or not statistics.has_null_count:
+                columns.pop(column.path_in_schema)
+                continue
+            summary["null_count"] += statistics.null_count
+            if (
+                statistics.null_count == row_group.num_rows
+                or column.path_in_schema in without_min_max
+            ):
+                # there's no min or max to contribute
+                continue
+            if not statistics.has_min_max:
+                summary["unknown_min_max"] = True
+                continue
+            if summary.get("min") is None or statistics.min < summary["min"]:
+                summary["min"] = statistics.min
+            if summary.get("max") is None or statistics.max > summary["max"]:
+                summary["max"] = statistics.max
+
+    for summary in columns.values():
+        if summary.pop("unknown_min_max", False):
+            summary.pop("min", None)
+            summary.pop("max", None)
+
+    return {"num_rows": metadata.num_rows, "schema": schema, "columns": columns}
+
+
+def orc_statistics(stream):
+    """
+    Read the row count from the footer of an orc file, pyarrow doesn't expose the
+    column statistics of orc files.
+    """
+    import pyarrow.orc as orc
+
+    orc_file = orc.ORCFile(stream)
+    return {"num_rows": orc_file.nrows, "schema": orc_file.schema, "columns": {}}
+
+
+# formats where we can get row counts and column statistics from the file metadata
+STATISTICS_READERS = {
+    "orc": orc_statistics,
+    "parquet": parquet_statistics,
+}
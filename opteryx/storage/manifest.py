@@ -0,0 +1,213 @@
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Blob manifests record a zone map for each of the data blobs in a partition: the
+number of rows, the size of the blob, a fingerprint of its schema and the minimum,
+maximum and null count of each of its columns. The reader uses the manifest to skip
+the blobs which can't contain rows matching the conditions pushed from the WHERE
+clause, without opening them.
+
+A manifest is built the first time a partition is read with conditions which could
+use it, from the footers of the Parquet and ORC blobs, other formats don't have
+statistics so they are always read. Manifests are saved as a Parquet file for each
+partition in the MANIFEST_PATH folder. The manifest is rebuilt if the blobs in the
+partition listing don't match the blobs in the manifest.
+
+The manifest is a table with a row for each blob, the statistics for each column of
+the blobs are in the `<column>$min`, `<column>$max` and `<column>$nulls` columns.
+"""
+import os
+import tempfile
+
+from typing import Dict, Iterable, List
+
+import pyarrow
+import pyarrow.parquet
+from cityhash import CityHash64
+
+from opteryx.storage.file_decoders import STATISTICS_READERS
+
+_COMPARISONS = {
+    "=": lambda low, high, value: low <= value <= high,
+    ">": lambda low, high, value: high > value,
+    ">=": lambda low, high, value: high >= value,
+    "<": lambda low, high, value: low < value,
+    "<=": lambda low, high, value: low <= value,
+}
+
+
+def _manifest_path(folder: str, reader, partition) -> str:
+    key = f"{type(reader).__name__}:{partition}"
+    return os.path.join(folder, f"{CityHash64(key):X}.parquet")
+
+
+def _blob_entry(reader, blob_name: str) -> Dict:
+    """read the statistics for a blob from its footer"""
+    statistics_reader = STATISTICS_READERS.get(blob_name.split(".")[-1])
+    if statistics_reader is None:
+        return {"blob": blob_name}
+    stream = reader.open_blob(blob_name)
+    try:
+        size = stream.seek(0, os.SEEK_END)
+        stream.seek(0)
+        statistics = statistics_reader(stream)
+    finally:
+        stream.close()
+    return {
+        "blob": blob_name,
+        "num_rows": statistics["num_rows"],
+        "bytes": size,
+        "schema": format(CityHash64(str(statistics["schema"])), "X"),
+        "columns": statistics["columns"],
+    }
+
+
+def build_manifest(reader, blob_names: Iterable[str]) -> pyarrow.Table:
+    """build the manifest table for the blobs"""
+    entries = [_blob_entry(reader, blob_name) for blob_name in sorted(blob_names)]
+
+    manifest = {
+        "blob": pyarrow.array([e["blob"] for e in entries], pyarrow.string()),
+        "num_rows": pyarrow.array(
+            [e.get("num_rows") for e in entries], pyarrow.int64()
+        ),
+        "bytes": pyarrow.array([e.get("bytes") for e in entries], pyarrow.int64()),
+        "schema": pyarrow.array([e.get("schema") for e in entries], pyarrow.string()),
+    }
+
+    column_types: Dict = {}
+    for entry in entries:
+        for column, summary in entry.get("columns", {}).items():
+            column_types.setdefault(column, set()).add(summary["type"])
+
+    for column, types in column_types.items():
+        # the blobs don't agree on the type of the column, we don't keep statistics
+        if len(types) != 1:
+            continue
+        column_type = types.pop()
+        summaries = [entry.get("columns", {}).get(column, {}) for entry in entries]
+        manifest[f"{column}$min"] = pyarrow.array(
+            [s.get("min") for s in summaries], column_type
+        )
+        manifest[f"{column}$max"] = pyarrow.array(
+            [s.get("max") for s in summaries], column_type
+        )
+        manifest[f"{column}$nulls"] = pyarrow.array(
+            [s.get("null_count") for s in summaries], pyarrow.int64()
+        )
+
+    return pyarrow.table(manifest)
+
+
+def _to_entries(manifest: pyarrow.Table) -> Dict:
+    """convert the manifest table to a dictionary of the statistics for each blob"""
+    # float columns may have NaNs, which aren't in the min, max or null count
+    floating = {
+        field.name[: -len("$min")]
+        for field in manifest.schema
+        if field.name.endswith("$min") and pyarrow.types.is_floating(field.type)
+    }
+    entries = {}
+    for row in manifest.to_pylist():
+        columns: Dict = {}
+        for name, value in row.items():
+            if "$" in name:
+                column, statistic = name.rsplit("$", 1)
+                columns.setdefault(column, {})[statistic] = value
+        for column in floating:
+            columns.setdefault(column, {})["floating"] = True
+        entries[row["blob"]] = {
+            "num_rows": row["num_rows"],
+            "bytes": row["bytes"],
+            "schema": row["schema"],
+            "columns": columns,
+        }
+    return entries
+
+
+def get_manifest(folder: str, reader, partition, blob_names: List[str]) -> Dict:
+    """
+    Get the manifest for a partition, the manifest is built if there isn't one or
+    the blobs in the manifest aren't the blobs in the partition.
+    """
+    path = _manifest_path(folder, reader, partition)
+    try:
+        manifest = pyarrow.parquet.read_table(path)
+        if sorted(manifest.column("blob").to_pylist()) == sorted(blob_names):
+            return _to_entries(manifest)
+    except (OSError, pyarrow.ArrowInvalid, KeyError):
+        pass
+
+    manifest = build_manifest(reader, blob_names)
+    # write to a temporary file and move it, so readers never see a partial file,
+    # each writer has its own temporary file so concurrent writers don't collide
+    os.makedirs(folder, exist_ok=True)
+    with tempfile.NamedTemporaryFile(
+        dir=folder, prefix=os.path.basename(path), suffix=".partial", delete=False
+    ) as temporary:
+        try:
+            pyarrow.parquet.write_table(manifest, temporary)
+        except Exception:
+            os.remove(temporary.name)
+            raise
+    os.replace(temporary.name, path)
+    return _to_entries(manifest)
+
+
+def can_match(entry: Dict, predicates: List) -> bool:
+    """
+    Could the blob contain rows which match all of the (column, operator, value)
+    conditions, if we don't know, we assume it could.
+    """
+    num_rows = entry.get("num_rows")
+    if num_rows is None:
+        return True
+    if num_rows == 0:
+        return False
+
+    for column, operator, value in predicates:
+        summary = entry["columns"].get(column)
+        if summary is None or summary.get("nulls") is None:
+            continue
+        nulls = summary["nulls"]
+
+        if operator == "IsNull":
+            # NaNs are treated as nulls, but aren't in the null count
+            if nulls == 0 and not summary.get("floating"):
+                return False
+            continue
+        # comparisons and IN lists are never true for nulls
+        if nulls == num_rows:
+            return False
+        if operator == "IsNotNull" or summary.get("floating"):
+            # NaNs aren't in the minimum and maximum, so we can't rule them out
+            continue
+
+        low, high = summary.get("min"), summary.get("max")
+        if low is None or high is None:
+            continue
+        try:
+            if operator == "in":
+                if not any(
+                    low <= item <= high
+                    for item in value.to_pylist()
+                    if item is not None
+                ):
+                    return False
+            elif not _COMPARISONS[operator](low, high, value):
+                return False
+        except TypeError:
+            # the value can't be compared with the statistics
+            continue
+
+    return True
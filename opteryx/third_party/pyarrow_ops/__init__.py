@@ -1,2 +1,2 @@
 from .join import align_tables, inner_join, left_join
-from .ops import drop_duplicates, ifilters
+from .ops import drop_duplicates, filter_mask
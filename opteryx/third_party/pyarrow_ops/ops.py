@@ -10,8 +10,21 @@ from opteryx.engine.attribute_types import PARQUET_TYPES
 from opteryx.engine.attribute_types import PYTHON_TYPES
 from opteryx.engine.attribute_types import TOKEN_TYPES
 
+from opteryx.utils import patterns
+
 from .helpers import columns_to_array
 
+# ADDED FOR OPTERYX
+# the pattern matching operators, the operator to match with and if it's negated
+PATTERN_OPERATORS = {
+    "like": ("like", False),
+    "not like": ("like", True),
+    "ilike": ("ilike", False),
+    "not ilike": ("ilike", True),
+    "~": ("~", False),
+    "!~": ("~", True),
+}
+
 
 def _get_type(var):
     # added for Opteryx
@@ -50,34 +63,34 @@ def arr_op_to_idxs(arr, operator, value):
         if value is None and identifier_type == TOKEN_TYPES.NUMERIC:
             # Nones are stored as NaNs, so perform a different test.
             # Tests against None should be IS NONE, not = NONE, this code is for = only
-            return numpy.where(numpy.isnan(arr))
+            return numpy.isnan(arr)
         if identifier_type != literal_type and value is not None:
             raise TypeError(
                 f"Type mismatch, unable to compare {identifier_type} with {literal_type}"
             )
-        return numpy.where(arr == value)
+        return arr == value
     elif operator in (
         "!=",
         "<>",
     ):
-        return numpy.where(arr != value)
+        return arr != value
     elif operator == "<":
-        return numpy.where(arr < value)
+        return arr < value
     elif operator == ">":
-        return numpy.where(arr > value)
+        return arr > value
     elif operator == "<=":
-        return numpy.where(arr <= value)
+        return arr <= value
     elif operator == ">=":
-        return numpy.where(arr >= value)
+        return arr >= value
     elif operator == "in":
         # MODIFIED FOR OPTERYX
         # some of the lists are saved as sets, which are faster than searching numpy
         # arrays, even with numpy's native functionality - choosing the right algo
         # is almost always faster than choosing a fast language.
-        return numpy.array([a in value for a in arr], dtype=numpy.bool8)
+        return numpy.array([a in value for a in arr], dtype=numpy.bool_)
     elif operator == "not in":
         # MODIFIED FOR OPTERYX - see comment above
-        return numpy.array([a not in value for a in arr], dtype=numpy.bool8)
+        return numpy.array([a not in value for a in arr], dtype=numpy.bool_)
     elif operator == "like":
         # MODIFIED FOR OPTERYX
         # null input emits null output, which should be false/0
@@ -131,24 +144,53 @@ def _get_values(table, operand):
         pass
 
 
-def ifilters(table, filters):
+def _match_pattern(table, left_operand, operator, right_operand):
     """
     ADDED FOR OPTERYX
-    return the indices so we can do unions (OR) and intersections (AND) on the lists
-    of indices to do complex filters
+    match a column against a LIKE, ILIKE or regular expression pattern, the column
+    isn't converted to a numpy array, the patterns are matched on the arrow array
     """
-    filters = [filters] if isinstance(filters, tuple) else filters
-    # Filter is a list of (col, op, value) tuples
-    indices = numpy.arange(table.num_rows)
-    for (left_operand, operator, right_operand) in filters:
-        f_idxs = arr_op_to_idxs(
-            _get_values(table, left_operand),
-            operator,
-            _get_values(table, right_operand),
-        )
-        indices = indices[f_idxs]
+    column = table.column(left_operand[0]).combine_chunks()
+    if column.null_count == len(column):
+        return numpy.full(len(column), False)
+    if pyarrow.types.is_dictionary(column.type):
+        column = column.dictionary_decode()
+    pattern_operator, negated = PATTERN_OPERATORS[operator]
+    if not (
+        pyarrow.types.is_string(column.type)
+        or pyarrow.types.is_large_string(column.type)
+    ):
+        _check_type(operator.upper(), _get_type(column), (TOKEN_TYPES.VARCHAR))
+    matches = patterns.match(column, pattern_operator, right_operand[0])
+    # null input emits null output, which should be false/0
+    if negated:
+        matches = compute.invert(compute.fill_null(matches, True))
+    else:
+        matches = compute.fill_null(matches, False)
+    return matches.to_numpy(zero_copy_only=False)
 
-    return indices
+
+def filter_mask(table, filter):
+    """
+    ADDED FOR OPTERYX
+    return a boolean mask of the rows which match a single (col, op, value) filter
+    """
+    left_operand, operator, right_operand = filter
+    if (
+        operator in PATTERN_OPERATORS
+        and left_operand[1] == TOKEN_TYPES.IDENTIFIER
+        and right_operand[1] == TOKEN_TYPES.VARCHAR
+    ):
+        return _match_pattern(table, left_operand, operator, right_operand)
+    mask = arr_op_to_idxs(
+        _get_values(table, left_operand),
+        operator,
+        _get_values(table, right_operand),
+    )
+    # comparisons numpy can't perform elementwise return a single value
+    if numpy.ndim(mask) == 0:
+        return numpy.full(table.num_rows, bool(mask))
+    return numpy.asarray(mask, dtype=numpy.bool_)
 
 
 # Drop duplicates
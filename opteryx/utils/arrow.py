@@ -16,6 +16,7 @@ This module contains support functions for working with PyArrow
 from typing import Iterable, List
 from pyarrow import Table
 
+import numpy
 import pyarrow
 
 from opteryx import config
@@ -242,3 +243,134 @@ def coerce_column(table, column_name):
         return table.cast(target_schema=my_schema)
 
     return table
+
+
+# constants for mixing column hashes together (FNV-1a and the murmur3 finalizer)
+_FNV_OFFSET = numpy.uint64(0xCBF29CE484222325)
+_FNV_PRIME = numpy.uint64(0x100000001B3)
+_MIX_CONSTANT = numpy.uint64(0xFF51AFD7ED558CCD)
+_NULL_HASH = numpy.uint64(0x9E3779B97F4A7C15)
+_SHIFT = numpy.uint64(33)
+
+
+def _hash_column(column):
+    """hash each of the values in a column, returns a numpy array of uint64s"""
+    from pyarrow import compute
+
+    if isinstance(column, pyarrow.ChunkedArray):
+        column = column.combine_chunks()
+    column_type = column.type
+
+    if pyarrow.types.is_dictionary(column_type):
+        column = column.cast(column_type.value_type)
+        column_type = column.type
+
+    if pyarrow.types.is_boolean(column_type):
+        column = column.cast(pyarrow.int8())
+        column_type = column.type
+
+    if pyarrow.types.is_floating(column_type):
+        # normalize -0.0 to 0.0 and all of the NaNs to a single value
+        values = column.cast(pyarrow.float64()).to_numpy(zero_copy_only=False) + 0.0
+        values[numpy.isnan(values)] = numpy.nan
+        hashes = values.view(numpy.uint64).copy()
+    elif pyarrow.types.is_integer(column_type) or pyarrow.types.is_temporal(
+        column_type
+    ):
+        # fixed width types are hashed as their integer representation
+        bit_width = column_type.bit_width
+        values = column.view(getattr(pyarrow, f"int{bit_width}")())
+        values = compute.fill_null(values.cast(pyarrow.int64()), 0)
+        hashes = values.to_numpy(zero_copy_only=False).view(numpy.uint64).copy()
+    else:
+        try:
+            # hash each unique value once
+            encoded = column.dictionary_encode()
+            dictionary_hashes = numpy.array(
+                [hash(value) for value in encoded.dictionary.to_pylist()] + [0],
+                dtype=numpy.int64,
+            ).view(numpy.uint64)
+            indices = compute.fill_null(encoded.indices, len(encoded.dictionary))
+            hashes = dictionary_hashes[indices.to_numpy(zero_copy_only=False)]
+        except pyarrow.ArrowNotImplementedError:  # lists and structs
+            hashes = numpy.array(
+                [hash(str(value)) for value in column.to_pylist()], dtype=numpy.int64
+            ).view(numpy.uint64)
+
+    if column.null_count > 0:
+        nulls = column.is_null().to_numpy(zero_copy_only=False)
+        hashes[nulls] = _NULL_HASH
+
+    return hashes
+
+
+def hash_columns(table: Table, columns: List[str]):
+    """
+    Create a hash for each row in a table, from the values in the named columns.
+
+    The hashes are only consistent within a process, they are used to distribute
+    rows between partitions, rows with the same values will have the same hash.
+    """
+    hashes = numpy.full(table.num_rows, _FNV_OFFSET, dtype=numpy.uint64)
+    for column in columns:
+        hashes ^= _hash_column(table.column(column))
+        hashes *= _FNV_PRIME
+    # avalanche so the low bits are useful for partitioning
+    hashes ^= hashes >> _SHIFT
+    hashes *= _MIX_CONSTANT
+    hashes ^= hashes >> _SHIFT
+    return hashes
+
+
+def partition_table(table: Table, columns: List[str], partitions: int) -> List[Table]:
+    """
+    Split a table into a number of partitions by the hash of the named columns, all
+    of the rows with the same values in these columns will be in the same partition.
+    """
+    if partitions <= 1 or len(columns) == 0:
+        return [table]
+    assignments = hash_columns(table, columns) % numpy.uint64(partitions)
+    order = numpy.argsort(assignments, kind="stable")
+    sizes = numpy.bincount(assignments.astype(numpy.int64), minlength=partitions)
+    table = table.take(order)
+    offset = 0
+    results = []
+    for size in sizes:
+        results.append(table.slice(offset, size))
+        offset += size
+    return results
+
+
+def as_array(values):
+    """
+    Convert the values a function is called with (an array, a chunked array, a numpy
+    array, a list or a single literal value) to an Arrow array.
+    """
+    if isinstance(values, pyarrow.Array):
+        return values
+    if isinstance(values, pyarrow.ChunkedArray):
+        return values.combine_chunks()
+    if isinstance(values, (numpy.ndarray, list, tuple)):
+        return pyarrow.array(values)
+    return pyarrow.array([values])
+
+
+def map_distinct(function, array, return_type=None):
+    """
+    Apply a function which works on one value at a time to an array, the function is
+    called once for each distinct value (including null) rather than for every row.
+    The values are passed to the function as numpy values.
+    """
+    from pyarrow import compute
+
+    array = as_array(array)
+    if pyarrow.types.is_dictionary(array.type):
+        array = array.cast(array.type.value_type)
+    try:
+        encoded = compute.dictionary_encode(array, null_encoding="encode")
+    except pyarrow.ArrowNotImplementedError:  # lists and structs
+        values = array.to_numpy(zero_copy_only=False)
+        return pyarrow.array([function(value) for value in values], type=return_type)
+    values = encoded.dictionary.to_numpy(zero_copy_only=False)
+    mapped = pyarrow.array([function(value) for value in values], type=return_type)
+    return mapped.take(encoded.indices)
@@ -95,6 +95,10 @@ class Columns:
         """get the preferred name for a given column"""
         return self._column_metadata[column]["preferred_name"]
 
+    def get_aliases(self, column):
+        """get all of the names a given column is known by"""
+        return self._column_metadata.get(column, {}).get("aliases", [])
+
     @property
     def table_name(self):
         """the name of the table these columns are in"""
@@ -0,0 +1,207 @@
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Compile LIKE, ILIKE and regular expression patterns to string matchers.
+
+Most patterns are a literal with a wildcard at the start, end or both ends (e.g.
+'abc%', '%abc' or '%abc%'), these are matched with the prefix, suffix and substring
+kernels, which compare the bytes of the strings without building a regular
+expression. Other patterns are matched as regular expressions.
+
+Patterns are classified the first time they are seen, and the classification is
+cached, so each pattern in a query is only classified once.
+
+A set of patterns, from LIKE conditions on the same column which are ORed together,
+is combined into a single regular expression, an alternation of the patterns, so
+each string is scanned once however many patterns there are.
+"""
+import functools
+
+from typing import Callable, Iterable
+
+import pyarrow
+from pyarrow import compute
+
+# characters which have a special meaning in regular expressions
+REGEX_SPECIAL_CHARACTERS = set(".^$*+?()[]{}|\\")
+
+
+def _matcher(kind: str, literal: str, ignore_case: bool) -> Callable:
+    if kind == "all":
+        # the pattern matches any string, nulls are null
+        return lambda array: compute.if_else(
+            compute.is_valid(array), True, pyarrow.scalar(None, pyarrow.bool_())
+        )
+    if kind == "equals":
+        if ignore_case:
+            return lambda array: compute.equal(
+                compute.utf8_lower(array), literal.lower()
+            )
+        return lambda array: compute.equal(array, literal)
+    kernel = {
+        "starts_with": compute.starts_with,
+        "ends_with": compute.ends_with,
+        "contains": compute.match_substring,
+    }[kind]
+    return lambda array: kernel(array, pattern=literal, ignore_case=ignore_case)
+
+
+def _classify_like(pattern: str):
+    """
+    the kind of match and the literal for a LIKE pattern, None if the pattern needs
+    to be matched with a regular expression
+    """
+    # _ matches any single character, \\ escapes the next character
+    if "_" in pattern or "\\" in pattern:
+        return None
+    literal = pattern.strip("%")
+    if "%" in literal:
+        return None
+    if literal == "" and pattern != "":
+        return "all", literal
+    starts = pattern.startswith("%")
+    ends = pattern.endswith("%")
+    if starts and ends:
+        return "contains", literal
+    if starts:
+        return "ends_with", literal
+    if ends:
+        return "starts_with", literal
+    return "equals", literal
+
+
+def _classify_regex(pattern: str):
+    """
+    the kind of match and the literal for a regular expression, None if the pattern
+    needs to be matched with a regular expression
+    """
+    starts = pattern.startswith("^")
+    ends = pattern.endswith("$") and not pattern.endswith("\\$")
+    literal = pattern[1 if starts else 0 : -1 if ends else None]
+    if any(character in REGEX_SPECIAL_CHARACTERS for character in literal):
+        return None
+    if literal == "" and not (starts and ends):
+        return "all", literal
+    if starts and ends:
+        return "equals", literal
+    if starts:
+        return "starts_with", literal
+    if ends:
+        return "ends_with", literal
+    return "contains", literal
+
+
+@functools.lru_cache(maxsize=256)
+def compile_like(pattern: str, ignore_case: bool = False) -> Callable:
+    """
+    Compile a LIKE (or ILIKE) pattern to a function which returns a boolean array of
+    the strings in an array which match the pattern, nulls are null.
+    """
+    classified = _classify_like(pattern)
+    if classified is None:
+        return lambda array: compute.match_like(
+            array, pattern=pattern, ignore_case=ignore_case
+        )
+    return _matcher(*classified, ignore_case)
+
+
+@functools.lru_cache(maxsize=256)
+def compile_regex(pattern: str) -> Callable:
+    """
+    Compile a regular expression to a function which returns a boolean array of the
+    strings in an array which contain a match for the pattern, nulls are null.
+    """
+    classified = _classify_regex(pattern)
+    if classified is None:
+        return lambda array: compute.match_substring_regex(array, pattern=pattern)
+    return _matcher(*classified, False)
+
+
+def _escape(literal: str) -> str:
+    return "".join(
+        f"\\{character}" if character in REGEX_SPECIAL_CHARACTERS else character
+        for character in literal
+    )
+
+
+def like_to_regex(pattern: str) -> str:
+    """
+    convert a LIKE pattern to a regular expression which finds a match in a string,
+    % matches any characters, _ matches any one character and \\ escapes the next
+    character
+    """
+    regex = []
+    characters = iter(pattern)
+    for character in characters:
+        if character == "\\":
+            regex.append(_escape(next(characters, "\\")))
+        elif character == "%":
+            regex.append(".*")
+        elif character == "_":
+            regex.append(".")
+        else:
+            regex.append(_escape(character))
+    # leading and trailing %s match anything, so they don't need to be anchored
+    start = 0
+    while start < len(regex) and regex[start] == ".*":
+        start += 1
+    end = len(regex)
+    while end > start and regex[end - 1] == ".*":
+        end -= 1
+    anchor_start = "^" if start == 0 else ""
+    anchor_end = "$" if end == len(regex) else ""
+    return anchor_start + "".join(regex[start:end]) + anchor_end
+
+
+@functools.lru_cache(maxsize=256)
+def compile_any(patterns: tuple, ignore_case: bool = False) -> Callable:
+    """
+    Compile a set of LIKE patterns to a function which returns a boolean array of the
+    strings in an array which match any of the patterns, nulls are null.
+    """
+    if any(_classify_like(pattern) == ("all", "") for pattern in patterns):
+        return _matcher("all", "", ignore_case)
+    if len(patterns) == 1:
+        return compile_like(patterns[0], ignore_case)
+    # (?s) lets . match new lines, as % and _ do
+    flags = "(?si)" if ignore_case else "(?s)"
+    regex = flags + "|".join(f"(?:{like_to_regex(pattern)})" for pattern in patterns)
+    return lambda array: compute.match_substring_regex(array, pattern=regex)
+
+
+def match_any(array, operator: str, patterns: Iterable[str]):
+    """
+    Match an array of strings against a set of LIKE or ILIKE patterns, true when any
+    of the patterns match.
+    """
+    if isinstance(array, pyarrow.ChunkedArray):
+        array = array.combine_chunks()
+    if operator not in ("like", "ilike"):
+        raise ValueError(f"Unknown pattern operator `{operator}`")
+    return compile_any(tuple(patterns), operator == "ilike")(array)
+
+
+def match(array, operator: str, pattern: str):
+    """
+    Match an array of strings against a LIKE, ILIKE or regular expression (~)
+    pattern, the NOT forms of the operators aren't handled here.
+    """
+    if isinstance(array, pyarrow.ChunkedArray):
+        array = array.combine_chunks()
+    if operator == "like":
+        return compile_like(pattern)(array)
+    if operator == "ilike":
+        return compile_like(pattern, True)(array)
+    if operator == "~":
+        return compile_regex(pattern)(array)
+    raise ValueError(f"Unknown pattern operator `{operator}`")
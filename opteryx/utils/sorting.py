@@ -0,0 +1,216 @@
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Parallel sorting of large tables.
+
+pyarrow's sort compares the ORDER BY columns one at a time on a single thread. For
+large tables we encode the ORDER BY columns into a single normalized key per row, an
+unsigned 64 bit integer which orders the same as the columns would (including the
+direction and nulls being last), chunks of the keys are then sorted in parallel and
+the sorted chunks merged.
+
+- integers, dates, times and booleans are offset from the smallest (or largest, for
+  descending) value
+- strings and other types are dictionary encoded and the dictionary is ranked
+- floats use their bit patterns, these need all 64 bits so they can only be used
+  when they're the only column being sorted
+
+If the columns can't be encoded into 64 bits, we fall back to pyarrow's sort.
+"""
+from concurrent.futures import ThreadPoolExecutor
+from typing import List
+
+import numpy
+import pyarrow
+from pyarrow import Table, compute
+
+from opteryx import config
+
+MAX_WORKER_THREADS = max(config.MAX_WORKER_THREADS, 1)
+# tables smaller than this are sorted by pyarrow
+PARALLEL_SORT_ROWS = 1000000
+# dictionaries larger than this fraction of the rows cost more to rank than we save
+MAX_DICTIONARY_RATIO = 0.5
+
+_SIGN_BIT = numpy.uint64(1 << 63)
+_NAN_KEY = numpy.uint64((1 << 64) - 2)
+_NULL_KEY = numpy.uint64((1 << 64) - 1)
+
+
+def _integer_key(column, direction):
+    """offset integer values so the smallest (or largest for descending) is zero"""
+    if pyarrow.types.is_boolean(column.type):
+        column = column.cast(pyarrow.int8())
+    elif not pyarrow.types.is_integer(column.type):
+        column = column.view(
+            pyarrow.int64() if column.type.bit_width == 64 else pyarrow.int32()
+        )
+    if pyarrow.types.is_uint64(column.type):
+        return None
+    valid = column.drop_null()
+    if len(valid) == 0:
+        return numpy.zeros(len(column), dtype=numpy.uint64), 1
+    low = compute.min_max(valid)
+    low, high = low["min"].as_py(), low["max"].as_py()
+    values = column.fill_null(low).to_numpy(zero_copy_only=False).astype(numpy.int64)
+    if direction == "ascending":
+        key = (values - low).astype(numpy.uint64)
+    else:
+        key = (high - values).astype(numpy.uint64)
+    cardinality = high - low + 1
+    if column.null_count > 0:
+        key[column.is_null().to_numpy(zero_copy_only=False)] = cardinality
+        cardinality += 1
+    return key, cardinality
+
+
+def _float_key(column, direction):
+    """
+    the bit pattern of a float orders the same as the value once negative values
+    have all of their bits flipped and positive values have the sign bit set
+    """
+    values = column.cast(pyarrow.float64()).fill_null(0).to_numpy(zero_copy_only=False)
+    # -0.0 and 0.0 are equal
+    values = values + 0.0
+    bits = values.view(numpy.uint64)
+    key = numpy.where(bits & _SIGN_BIT, ~bits, bits | _SIGN_BIT)
+    if direction != "ascending":
+        key = ~key
+    # NaNs are after the values, nulls are after the NaNs
+    key[numpy.isnan(values)] = _NAN_KEY
+    if column.null_count > 0:
+        key[column.is_null().to_numpy(zero_copy_only=False)] = _NULL_KEY
+    return key, 1 << 64
+
+
+def _dictionary_key(column, direction):
+    """rank the dictionary of the column, the key is the rank of the value"""
+    if not pyarrow.types.is_dictionary(column.type):
+        column = column.dictionary_encode()
+    if len(column.dictionary) > len(column) * MAX_DICTIONARY_RATIO:
+        return None
+    ranks = compute.rank(column.dictionary, sort_keys=direction, tiebreaker="dense")
+    ranks = ranks.to_numpy().astype(numpy.uint64) - numpy.uint64(1)
+    cardinality = int(ranks.max()) + 1 if len(ranks) > 0 else 0
+    indices = column.indices.fill_null(0).to_numpy(zero_copy_only=False)
+    key = ranks[indices] if len(ranks) > 0 else numpy.zeros(len(column), numpy.uint64)
+    if column.null_count > 0:
+        key[column.is_null().to_numpy(zero_copy_only=False)] = cardinality
+        cardinality += 1
+    return key, cardinality
+
+
+def _column_key(column, direction):
+    if isinstance(column, pyarrow.ChunkedArray):
+        column = column.combine_chunks()
+    column_type = column.type
+    if pyarrow.types.is_floating(column_type):
+        return _float_key(column, direction)
+    if (
+        pyarrow.types.is_integer(column_type)
+        or pyarrow.types.is_boolean(column_type)
+        or pyarrow.types.is_date(column_type)
+        or pyarrow.types.is_time(column_type)
+        or pyarrow.types.is_timestamp(column_type)
+    ):
+        return _integer_key(column, direction)
+    if pyarrow.types.is_nested(column_type):
+        return None
+    return _dictionary_key(column, direction)
+
+
+def normalized_keys(table: Table, order: List):
+    """
+    encode the ORDER BY columns into a single uint64 key for each row, returns None
+    if the columns can't be encoded into 64 bits
+    """
+    key = None
+    capacity = 1
+    for column, direction in order:
+        column_key = _column_key(table[column], direction)
+        if column_key is None:
+            return None
+        values, cardinality = column_key
+        cardinality = max(int(cardinality), 1)
+        # capacity is a Python int, so it can't overflow
+        capacity *= cardinality
+        if capacity > 1 << 64:
+            return None
+        if key is None:
+            key = values
+        elif cardinality >= 1 << 64:
+            # a column which needs all 64 bits (e.g. floats) can't follow another
+            # column, even when the earlier columns only have one value
+            return None
+        else:
+            key = key * numpy.uint64(cardinality) + values
+    return key
+
+
+def _merge(left, right):
+    """
+    merge two sorted (index, key) runs, the left run is before the right in the
+    table, so for equal keys rows from the left run go first to keep the sort stable
+    """
+    left_indices, left_keys = left
+    right_indices, right_keys = right
+    positions = numpy.searchsorted(left_keys, right_keys, side="right")
+    positions += numpy.arange(len(right_keys))
+    from_right = numpy.zeros(len(left_keys) + len(right_keys), dtype=bool)
+    from_right[positions] = True
+
+    indices = numpy.empty(len(from_right), dtype=numpy.int64)
+    keys = numpy.empty(len(from_right), dtype=numpy.uint64)
+    indices[from_right] = right_indices
+    indices[~from_right] = left_indices
+    keys[from_right] = right_keys
+    keys[~from_right] = left_keys
+    return indices, keys
+
+
+def sort_indices(table: Table, order: List, threads: int = MAX_WORKER_THREADS):
+    """
+    the stable sort order of the rows in the table, as a numpy array, returns None
+    if the table should be sorted by pyarrow
+    """
+    if table.num_rows < PARALLEL_SORT_ROWS or threads < 2:
+        return None
+    keys = normalized_keys(table, order)
+    if keys is None:
+        return None
+
+    def _sort_chunk(bounds):
+        start, end = bounds
+        chunk_order = numpy.argsort(keys[start:end], kind="stable")
+        return chunk_order + start, keys[start:end][chunk_order]
+
+    boundaries = numpy.linspace(0, len(keys), threads + 1, dtype=numpy.int64)
+    with ThreadPoolExecutor(max_workers=threads) as pool:
+        runs = list(pool.map(_sort_chunk, zip(boundaries[:-1], boundaries[1:])))
+        # merge adjacent pairs of runs until there's only one
+        while len(runs) > 1:
+            pairs = [runs[i : i + 2] for i in range(0, len(runs), 2)]
+            runs = list(
+                pool.map(
+                    lambda pair: _merge(*pair) if len(pair) == 2 else pair[0], pairs
+                )
+            )
+    return runs[0][0]
+
+
+def sort_table(table: Table, order: List) -> Table:
+    """sort a table, in parallel if it's large enough to benefit"""
+    indices = sort_indices(table, order)
+    if indices is None:
+        return table.sort_by(order)
+    return table.take(pyarrow.array(indices))
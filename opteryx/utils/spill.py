@@ -0,0 +1,112 @@
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""
+Spill files are used by operators which have exceeded their memory budget to write
+intermediate data to local disk.
+
+The data is written as Arrow IPC streams, one stream per partition, each partition
+can be read back independently of the others so the operator only needs to hold one
+partition in memory at a time. Partitions can also be streamed back a batch at a
+time, e.g. the sorted runs of an external sort.
+"""
+import os
+import shutil
+import tempfile
+
+from typing import Dict, Iterable
+
+import pyarrow
+from pyarrow import ipc
+
+from opteryx import config
+
+
+class SpillFiles:
+    """
+    A set of partitioned spill files, these are removed when the spill is closed.
+
+    Usage:
+        with SpillFiles(partitions=8) as spill:
+            spill.write(0, table)
+            table = spill.read(0)
+    """
+
+    def __init__(self, partitions: int = 0, prefix: str = "opteryx-spill-"):
+        self.partitions = partitions
+        self.bytes_written: int = 0
+        self._folder = tempfile.mkdtemp(prefix=prefix, dir=config.SPILL_PATH)
+        self._writers: Dict[int, ipc.RecordBatchStreamWriter] = {}
+        self._sinks: Dict = {}
+        self._schema = None
+
+    def _path(self, partition: int) -> str:
+        return os.path.join(self._folder, f"{partition:05}.arrow")
+
+    def write(self, partition: int, table: pyarrow.Table, max_chunksize: int = None):
+        """
+        append a table to the spill file for a partition, max_chunksize limits the
+        number of rows in each of the batches the table is written as
+        """
+        if table.num_rows == 0:
+            return
+        if self._schema is None:
+            self._schema = table.schema
+        elif table.schema != self._schema:
+            table = table.cast(self._schema)
+        writer = self._writers.get(partition)
+        if writer is None:
+            sink = pyarrow.OSFile(self._path(partition), "wb")
+            writer = ipc.new_stream(sink, self._schema)
+            self._sinks[partition] = sink
+            self._writers[partition] = writer
+        writer.write_table(table, max_chunksize=max_chunksize)
+        self.bytes_written += table.nbytes
+
+    def read(self, partition: int) -> pyarrow.Table:
+        """read all of the data spilled to a partition, returns None if empty"""
+        writer = self._writers.pop(partition, None)
+        if writer is None:
+            return None
+        writer.close()
+        self._sinks.pop(partition).close()
+        with pyarrow.OSFile(self._path(partition), "rb") as source:
+            table = ipc.open_stream(source).read_all()
+        os.remove(self._path(partition))
+        return table
+
+    def stream(self, partition: int) -> Iterable[pyarrow.Table]:
+        """read the data spilled to a partition back one batch at a time"""
+        writer = self._writers.pop(partition, None)
+        if writer is None:
+            return
+        writer.close()
+        self._sinks.pop(partition).close()
+        with pyarrow.OSFile(self._path(partition), "rb") as source:
+            for batch in ipc.open_stream(source):
+                yield pyarrow.Table.from_batches([batch])
+        os.remove(self._path(partition))
+
+    def close(self):
+        for writer in self._writers.values():
+            writer.close()
+        for sink in self._sinks.values():
+            sink.close()
+        self._writers = {}
+        self._sinks = {}
+        shutil.rmtree(self._folder, ignore_errors=True)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
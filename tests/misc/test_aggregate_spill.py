@@ -0,0 +1,192 @@
+"""
+When the aggregation states exceed MAX_OPERATOR_MEMORY they're written to disk,
+partitioned by the group keys, and each partition is merged and finalized on its
+own. The results must be the same as when the states are held in memory.
+
+For ROLLUP, CUBE and GROUPING SETS the coarser groupings are spilled again, rather
+than holding all of the partitions to derive them.
+"""
+import os
+import sys
+
+import numpy
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine import QueryDirectives, QueryStatistics
+from opteryx.engine.attribute_types import TOKEN_TYPES
+from opteryx.engine.planner.operations import aggregate_node
+from opteryx.utils.columns import Columns
+
+
+class _Pages:
+    def __init__(self, table, size):
+        self.table = table
+        self.size = size
+
+    def execute(self):
+        for start in range(0, self.table.num_rows, self.size):
+            yield self.table.slice(start, self.size)
+
+
+def _table(rows):
+    random = numpy.random.default_rng(7)
+    table = pyarrow.table(
+        {
+            "a": pyarrow.array(
+                random.integers(0, 50, rows), mask=random.random(rows) < 0.1
+            ),
+            "b": pyarrow.array(
+                random.integers(0, 20, rows).astype(str),
+                mask=random.random(rows) < 0.1,
+            ),
+            "value": pyarrow.array(
+                random.integers(0, 1000, rows).astype(float),
+                mask=random.random(rows) < 0.1,
+            ),
+        }
+    )
+    return Columns.create_table_metadata(table, rows, "t", None)
+
+
+def _aggregate(function, column, distinct=False):
+    if column == "*":
+        return {"aggregate": function, "args": [("Wildcard", TOKEN_TYPES.WILDCARD)]}
+    return {
+        "aggregate": function,
+        "args": [(column, TOKEN_TYPES.IDENTIFIER)],
+        "distinct": distinct,
+    }
+
+
+def _run(table, max_operator_memory, **config):
+    statistics = QueryStatistics()
+    memory = aggregate_node.MAX_OPERATOR_MEMORY
+    aggregate_node.MAX_OPERATOR_MEMORY = max_operator_memory
+    try:
+        node = aggregate_node.AggregateNode(QueryDirectives(), statistics, **config)
+        node.set_producers([_Pages(table, 1000)])
+        result = pyarrow.concat_tables(node.execute())
+    finally:
+        aggregate_node.MAX_OPERATOR_MEMORY = memory
+
+    columns = Columns(result)
+    result = result.rename_columns(
+        [columns.get_preferred_name(column) for column in result.column_names]
+    )
+    # the order of the groups isn't defined, so compare the sorted rows
+    rows = sorted(result.to_pylist(), key=lambda row: repr(sorted(row.items())))
+    return rows, statistics
+
+
+def test_spilled_aggregation():
+
+    table = _table(20000)
+    config = {
+        "groups": ["a", "b"],
+        "aggregates": [
+            _aggregate("COUNT", "*"),
+            _aggregate("SUM", "value"),
+            _aggregate("AVG", "value"),
+            _aggregate("MIN", "b"),
+            # these are list states
+            _aggregate("COUNT", "value", distinct=True),
+            _aggregate("MEDIAN", "value"),
+            {
+                "aggregate": "PERCENTILE_DISC",
+                "args": [
+                    ("value", TOKEN_TYPES.IDENTIFIER),
+                    (0.9, TOKEN_TYPES.NUMERIC),
+                ],
+            },
+            {"identifier": "a"},
+            {"identifier": "b"},
+        ],
+    }
+
+    expected, statistics = _run(table, 1 << 40, **config)
+    assert statistics.spills == 0
+
+    rows, statistics = _run(table, 20000, **config)
+    assert statistics.spills > 0
+    assert statistics.bytes_spilled > 0
+    assert rows == expected
+
+    # the rows with null keys are groups too
+    assert any(row["a"] is None and row["b"] is None for row in rows)
+    assert sum(row["COUNT(*)"] for row in rows) == 20000
+
+
+def test_spilled_grouping_sets():
+
+    table = _table(20000)
+    config = {
+        "groups": ["a", "b"],
+        # ROLLUP (a, b)
+        "grouping_sets": [["a", "b"], ["a"], []],
+        "aggregates": [
+            _aggregate("COUNT", "*"),
+            _aggregate("SUM", "value"),
+            _aggregate("MAX", "b"),
+            {"identifier": "a"},
+            {"identifier": "b"},
+        ],
+    }
+
+    expected, statistics = _run(table, 1 << 40, **config)
+    assert statistics.spills == 0
+
+    rows, statistics = _run(table, 1, **config)
+    assert statistics.spills > 0
+    assert len(rows) == len(expected)
+    assert rows == expected
+
+    # the grand total is one of the rows
+    assert {"COUNT(*)": 20000, "a": None, "b": None} in [
+        {key: row[key] for key in ("COUNT(*)", "a", "b")} for row in rows
+    ]
+
+
+def test_spilled_grouping_sets_are_streamed():
+
+    reads: list = []
+    spill_files = aggregate_node.SpillFiles
+
+    class _SpillFiles(spill_files):
+        def read(self, partition):
+            reads.append(self)
+            return super().read(partition)
+
+    table = _table(20000)
+    config = {
+        "groups": ["a", "b"],
+        "grouping_sets": [["a", "b"], []],
+        "aggregates": [_aggregate("COUNT", "*"), {"identifier": "a"}],
+    }
+    memory = aggregate_node.MAX_OPERATOR_MEMORY
+    output_page_rows = aggregate_node.OUTPUT_PAGE_ROWS
+    aggregate_node.MAX_OPERATOR_MEMORY = 1
+    aggregate_node.OUTPUT_PAGE_ROWS = 1
+    aggregate_node.SpillFiles = _SpillFiles
+    try:
+        node = aggregate_node.AggregateNode(
+            QueryDirectives(), QueryStatistics(), **config
+        )
+        node.set_producers([_Pages(table, 1000)])
+        pages = node.execute()
+        next(pages)
+        # the first partition is finalized before the next one is read
+        assert len(reads) == 1, len(reads)
+        assert sum(page.num_rows for page in pages) > 0
+    finally:
+        aggregate_node.MAX_OPERATOR_MEMORY = memory
+        aggregate_node.OUTPUT_PAGE_ROWS = output_page_rows
+        aggregate_node.SpillFiles = spill_files
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_spilled_aggregation()
+    test_spilled_grouping_sets()
+    test_spilled_grouping_sets_are_streamed()
+    print("okay")
@@ -0,0 +1,136 @@
+"""
+The blob manifest records the statistics of each blob in a partition, the reader
+uses it to skip the blobs which can't match the selection. The manifest is rebuilt
+when blobs are added or removed from the partition.
+"""
+import os
+import sys
+import tempfile
+
+import numpy
+import pyarrow
+import pyarrow.parquet
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine import QueryDirectives, QueryStatistics
+from opteryx.engine.planner.operations import blob_reader_node
+from opteryx.storage import manifest
+from opteryx.storage.adapters import DiskStorage
+
+
+def _write_blob(folder, index):
+    table = pyarrow.table(
+        {
+            "id": pyarrow.array(range(index * 100, index * 100 + 100)),
+            "label": pyarrow.array([None] * 100, pyarrow.string()),
+        }
+    )
+    pyarrow.parquet.write_table(table, os.path.join(folder, f"{index:04}.parquet"))
+
+
+def _read(dataset, predicates):
+    statistics = QueryStatistics()
+    node = blob_reader_node.BlobReaderNode(
+        directives=QueryDirectives(),
+        statistics=statistics,
+        dataset=dataset,
+        reader=DiskStorage,
+        cache=None,
+        hints=["NO_PARTITION"],
+        selection=predicates,
+    )
+    rows = sum(page.num_rows for page in node.execute())
+    return rows, statistics
+
+
+def test_blob_manifest_prunes_blobs():
+
+    with tempfile.TemporaryDirectory() as folder:
+        data_folder = os.path.join(folder, "data")
+        os.makedirs(data_folder)
+        for index in range(10):
+            _write_blob(data_folder, index)
+
+        blob_reader_node.MANIFEST_PATH = os.path.join(folder, "manifests")
+        try:
+            # the manifest is built when the partition is first read
+            predicates = [("id", ">=", numpy.float64(850))]
+            rows, statistics = _read(data_folder, predicates)
+            assert statistics.count_blobs_pruned == 8, statistics.count_blobs_pruned
+            assert statistics.count_data_blobs_read == 2
+            assert rows == 150, rows
+            assert len(os.listdir(blob_reader_node.MANIFEST_PATH)) == 1
+
+            predicates = [("id", "in", pyarrow.array([5.0, 505.0]))]
+            rows, statistics = _read(data_folder, predicates)
+            assert statistics.count_data_blobs_read == 2
+
+            # all of the labels are null
+            rows, statistics = _read(data_folder, [("label", "IsNotNull", None)])
+            assert statistics.count_data_blobs_read == 1
+
+            # adding a blob invalidates the manifest
+            _write_blob(data_folder, 10)
+            predicates = [("id", ">=", numpy.float64(850))]
+            rows, statistics = _read(data_folder, predicates)
+            assert statistics.count_data_blobs_read == 3
+            assert rows == 250, rows
+        finally:
+            blob_reader_node.MANIFEST_PATH = None
+
+
+def test_blob_manifest_can_match():
+
+    entry = {
+        "num_rows": 10,
+        "columns": {"a": {"min": 1, "max": 5, "nulls": 0}, "b": {"nulls": 10}},
+    }
+    assert manifest.can_match(entry, [("a", "=", 5.0)])
+    assert not manifest.can_match(entry, [("a", ">", 5.0)])
+    assert not manifest.can_match(entry, [("a", "IsNull", None)])
+    assert not manifest.can_match(entry, [("b", "<", 5.0)])
+    assert manifest.can_match(entry, [("b", "IsNull", None)])
+    # values which can't be compared, and unknown columns, might match
+    assert manifest.can_match(entry, [("a", "=", "one")])
+    assert manifest.can_match(entry, [("c", "=", 5.0)])
+    assert manifest.can_match({"num_rows": None}, [("a", ">", 5.0)])
+
+    # nulls can only be ruled out when there are none
+    entry["columns"]["c"] = {"min": 1, "max": 5, "nulls": 2}
+    assert manifest.can_match(entry, [("c", "IsNull", None)])
+    # floats may have NaNs, which aren't in the null count, minimum or maximum
+    entry["columns"]["f"] = {"min": 1.0, "max": 5.0, "nulls": 0, "floating": True}
+    assert manifest.can_match(entry, [("f", "IsNull", None)])
+    assert manifest.can_match(entry, [("f", ">", 5.0)])
+    entry["columns"]["f"] = {"min": None, "max": None, "nulls": 0, "floating": True}
+    assert manifest.can_match(entry, [("f", "IsNull", None)])
+
+
+def test_blob_manifest_floats_and_temporary_files():
+
+    with tempfile.TemporaryDirectory() as folder:
+        data_folder = os.path.join(folder, "data")
+        os.makedirs(data_folder)
+        table = pyarrow.table({"value": pyarrow.array([1.0, numpy.nan, 3.0])})
+        pyarrow.parquet.write_table(table, os.path.join(data_folder, "0000.parquet"))
+
+        blob_reader_node.MANIFEST_PATH = os.path.join(folder, "manifests")
+        try:
+            # the NaN is treated as null, so the blob can't be skipped
+            rows, statistics = _read(data_folder, [("value", "IsNull", None)])
+            assert statistics.count_data_blobs_read == 1
+            rows, statistics = _read(data_folder, [("value", ">", numpy.float64(5))])
+            assert statistics.count_data_blobs_read == 1
+            # only the manifest is left, not the temporary file it was written to
+            files = os.listdir(blob_reader_node.MANIFEST_PATH)
+            assert len(files) == 1 and files[0].endswith(".parquet"), files
+        finally:
+            blob_reader_node.MANIFEST_PATH = None
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_blob_manifest_prunes_blobs()
+    test_blob_manifest_can_match()
+    test_blob_manifest_floats_and_temporary_files()
+    print("okay")
@@ -0,0 +1,70 @@
+"""
+When the reader only needs some of the rows in a file, the decoders are given an
+offset and a limit, they must return the same rows as slicing the whole file.
+"""
+import io
+import os
+import sys
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.storage import file_decoders
+
+FORMATS = {
+    "arrow": file_decoders.arrow_decoder,
+    "jsonl": file_decoders.jsonl_decoder,
+    "orc": file_decoders.orc_decoder,
+    "parquet": file_decoders.parquet_decoder,
+}
+
+WINDOWS = [(0, 10), (5, 0), (99990, 100), (123, 70000), (100000, 5)]
+
+
+def _read(path):
+    with open(path, "rb") as file:
+        return io.BytesIO(file.read())
+
+
+def test_decoder_limits():
+
+    for format_name, decoder in FORMATS.items():
+        path = f"tests/data/formats/{format_name}/tweets.{format_name}"
+        full = decoder(_read(path), None)
+
+        for offset, limit in WINDOWS:
+            table = decoder(_read(path), None, offset=offset, limit=limit)
+            expected = full.slice(offset, limit)
+            assert table.column_names == full.column_names, format_name
+            assert table.num_rows == expected.num_rows, (format_name, offset, limit)
+            assert (
+                table.column("tweet_id").to_pylist()
+                == expected.column("tweet_id").to_pylist()
+            ), (format_name, offset, limit)
+
+
+def test_decoder_limits_with_projection():
+
+    path = "tests/data/formats/parquet/tweets.parquet"
+    table = file_decoders.parquet_decoder(
+        _read(path), ["user_name"], offset=10, limit=5
+    )
+    assert table.shape == (5, 1), table.shape
+
+
+def test_decoder_projection_ignores_unknown_columns():
+
+    for format_name, decoder in FORMATS.items():
+        path = f"tests/data/formats/{format_name}/tweets.{format_name}"
+        table = decoder(_read(path), ["user_name", "not_a_column", "tweet_id"])
+        # the columns are in the order they are in the file
+        assert table.column_names == ["tweet_id", "user_name"], format_name
+        # if none of the columns are in the file, all of the columns are read
+        table = decoder(_read(path), ["not_a_column"])
+        assert table.num_columns == 13, format_name
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_decoder_limits()
+    test_decoder_limits_with_projection()
+    test_decoder_projection_ignores_unknown_columns()
+    print("okay")
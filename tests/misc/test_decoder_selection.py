@@ -0,0 +1,66 @@
+"""
+Simple WHERE conditions are pushed to the Parquet and ORC decoders, the rows they
+return must match filtering the whole file, and conditions which can't be applied
+must leave the data unfiltered for the Selection Node to deal with.
+"""
+import io
+import os
+import sys
+
+import numpy
+import pyarrow
+import pyarrow.parquet
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine.planner.operations.blob_reader_node import _to_expression
+from opteryx.storage import file_decoders
+
+
+def _read(path):
+    with open(path, "rb") as file:
+        return io.BytesIO(file.read())
+
+
+def test_selection_pushdown():
+
+    selection = _to_expression(
+        [("followers", ">", numpy.float64(100000)), ("user_verified", "=", True)]
+    )
+    for format_name, decoder in (
+        ("parquet", file_decoders.parquet_decoder),
+        ("orc", file_decoders.orc_decoder),
+    ):
+        path = f"tests/data/formats/{format_name}/tweets.{format_name}"
+        table = decoder(_read(path), None, selection=selection)
+        assert table.num_rows == 156, (format_name, table.num_rows)
+
+
+def test_selection_skips_row_groups():
+
+    buffer = io.BytesIO()
+    pyarrow.parquet.write_table(
+        pyarrow.table({"a": numpy.arange(100000)}), buffer, row_group_size=10000
+    )
+    selection = _to_expression(
+        [("a", ">=", numpy.float64(95000)), ("a", "in", pyarrow.array([1, 95001]))]
+    )
+    buffer.seek(0)
+    table = file_decoders.parquet_decoder(buffer, None, selection=selection)
+    assert table.column("a").to_pylist() == [95001]
+
+
+def test_selection_which_cant_be_applied():
+
+    # comparing a string to a number can't be done by the decoder
+    selection = _to_expression([("user_name", ">", numpy.float64(3))])
+    path = "tests/data/formats/parquet/tweets.parquet"
+    table = file_decoders.parquet_decoder(_read(path), None, selection=selection)
+    assert table.num_rows == 100000
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_selection_pushdown()
+    test_selection_skips_row_groups()
+    test_selection_which_cant_be_applied()
+    print("okay")
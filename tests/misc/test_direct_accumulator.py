@@ -0,0 +1,116 @@
+"""
+GROUP BY a dictionary encoded column accumulates the states into arrays indexed by
+the dictionary codes. A dictionary can have the same value more than once (e.g. when
+chunks with different dictionaries are combined), these entries are the same group
+so their states must all be added.
+
+When there are too many groups, the states are handed to the hash aggregation, each
+page has its own dictionary so the keys must be decoded before they're combined.
+"""
+import os
+import sys
+
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine import QueryDirectives, QueryStatistics
+from opteryx.engine.attribute_types import TOKEN_TYPES
+from opteryx.engine.planner.operations import aggregate_node
+from opteryx.engine.planner.operations.aggregate_node import DirectAccumulator
+from opteryx.utils.columns import Columns
+
+
+class _Pages:
+    def __init__(self, table):
+        self.table = table
+
+    def execute(self):
+        # each batch was encoded separately, so has its own dictionary
+        for batch in self.table.to_batches():
+            yield pyarrow.Table.from_batches([batch])
+
+
+def test_repeated_dictionary_values():
+
+    keys = pyarrow.DictionaryArray.from_arrays(
+        pyarrow.array([0, 1, 2, 0, 2, None, 3]),
+        pyarrow.array(["a", "b", "a", "b"]),
+    )
+    values = pyarrow.array([1, 2, 4, 8, 16, 32, None])
+    page = pyarrow.table({"key": keys, "value": values})
+    aggregations = [
+        (None, "count_all", "count_all"),
+        ("value", "count", "count"),
+        ("value", "sum", "sum"),
+        ("value", "min", "min"),
+        ("value", "max", "max"),
+    ]
+    assert DirectAccumulator.eligible(page, ["key"], aggregations)
+
+    accumulator = DirectAccumulator("key", page.schema, aggregations)
+    # the same page twice, so the keys are in the accumulators already
+    accumulator.add(accumulator.partial(page))
+    accumulator.add(accumulator.partial(page))
+
+    table = accumulator.to_table()
+    results = {row["key"]: row for row in table.to_pylist()}
+    assert results["a"]["count_all"] == 8, results
+    assert results["a"]["sum"] == 58, results
+    assert results["a"]["min"] == 1 and results["a"]["max"] == 16, results
+    assert results["b"]["count_all"] == 4 and results["b"]["count"] == 2, results
+    assert results["b"]["sum"] == 4, results
+    assert results[None]["count_all"] == 2 and results[None]["sum"] == 64, results
+
+
+def test_switch_to_hashing():
+
+    pages = []
+    for page in range(6):
+        keys = [None if i % 17 == 0 else f"k{(page * 7 + i) % 40}" for i in range(100)]
+        pages.append(
+            pyarrow.table(
+                {"key": pyarrow.array(keys).dictionary_encode(), "value": range(100)}
+            )
+        )
+    table = pyarrow.concat_tables(pages)
+    table = Columns.create_table_metadata(table, table.num_rows, "t", None)
+
+    expected: dict = {}
+    for key, value in zip(table.column(0).to_pylist(), table.column(1).to_pylist()):
+        count, total = expected.get(key, (0, 0))
+        expected[key] = (count + 1, total + value)
+
+    max_direct_groups = aggregate_node.MAX_DIRECT_GROUPS
+    # the pages are accumulated directly until there are more than 10 groups
+    aggregate_node.MAX_DIRECT_GROUPS = 10
+    try:
+        node = aggregate_node.AggregateNode(
+            QueryDirectives(),
+            QueryStatistics(),
+            groups=["key"],
+            aggregates=[
+                {"aggregate": "COUNT", "args": [("Wildcard", TOKEN_TYPES.WILDCARD)]},
+                {"aggregate": "SUM", "args": [("value", TOKEN_TYPES.IDENTIFIER)]},
+                {"identifier": "key"},
+            ],
+        )
+        node.set_producers([_Pages(table)])
+        result = pyarrow.concat_tables(node.execute())
+    finally:
+        aggregate_node.MAX_DIRECT_GROUPS = max_direct_groups
+
+    columns = Columns(result)
+    result = result.rename_columns(
+        [columns.get_preferred_name(column) for column in result.column_names]
+    )
+    results = {
+        row["key"]: (row["COUNT(*)"], row["SUM(value)"]) for row in result.to_pylist()
+    }
+    assert results == expected, results
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_repeated_dictionary_values()
+    test_switch_to_hashing()
+    print("okay")
@@ -0,0 +1,62 @@
+"""
+The set of rows DISTINCT has seen holds the hashes in sorted runs which are merged as
+they grow, so adding a page doesn't copy the whole set. Rows with colliding hashes
+must still be compared by their values.
+"""
+import math
+import os
+import sys
+
+import numpy
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine.planner.operations import distinct_node
+
+
+def _distinct(table, page_size):
+    seen = distinct_node.DistinctSet(table.column_names)
+    rows = []
+    for start in range(0, table.num_rows, page_size):
+        page = table.slice(start, page_size)
+        rows.extend(page.take(pyarrow.array(seen.new_rows(page))).to_pylist())
+    return rows, seen
+
+
+def test_distinct_set_runs():
+
+    values = numpy.random.default_rng(1).permutation(200000)
+    table = pyarrow.table({"a": values})
+    rows, seen = _distinct(table, 1000)
+    assert len(rows) == 200000
+    # the runs grow geometrically, so there are only a few of them
+    assert len(seen.runs) <= math.log2(200000) + 1, len(seen.runs)
+    assert sum(len(hashes) for hashes, _ in seen.runs) == 200000
+
+    # seeing the rows again doesn't add anything
+    for start in range(0, table.num_rows, 5000):
+        assert len(seen.new_rows(table.slice(start, 5000))) == 0
+
+
+def test_distinct_set_collisions():
+
+    hash_columns = distinct_node.hash_columns
+    # only 8 different hashes, so most of the rows collide
+    distinct_node.hash_columns = lambda table, columns: (
+        hash_columns(table, columns) % numpy.uint64(8)
+    )
+    try:
+        values = [1, 2, None, 3, 2, 1, None, 4, 5, 6, 7, 8, 9, 10, 3, 11]
+        table = pyarrow.table({"a": values * 5})
+        rows, _ = _distinct(table, 3)
+        expected = list(dict.fromkeys(values))
+        assert [row["a"] for row in rows] == expected, rows
+    finally:
+        distinct_node.hash_columns = hash_columns
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_distinct_set_runs()
+    test_distinct_set_collisions()
+    print("okay")
@@ -0,0 +1,136 @@
+"""
+Function calls are compiled to steps when the plan is built, functions can be the
+arguments of other functions, each distinct call is evaluated once for each page,
+calls with only literal arguments are evaluated once for the query, and functions
+evaluated for the SELECT clause are reused by the WHERE clause.
+"""
+import os
+import sys
+
+import pyarrow
+from pyarrow import compute
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine import QueryDirectives, QueryStatistics
+from opteryx.engine.attribute_types import TOKEN_TYPES
+from opteryx.engine.functions import FUNCTIONS
+from opteryx.engine.planner.operations import EvaluationNode, SelectionNode
+from opteryx.engine.planner.operations.evaluation_node import Expressions
+from opteryx.utils.columns import Columns
+
+
+class _Pages:
+    def __init__(self, table, size):
+        self.table = table
+        self.size = size
+
+    def execute(self):
+        for start in range(0, self.table.num_rows, self.size):
+            yield self.table.slice(start, self.size)
+
+
+def _table():
+    names = ["Mercury", "Venus", "Earth", "Mars", "Jupiter", "Saturn", "Uranus"]
+    table = pyarrow.table({"name": names})
+    return Columns.create_table_metadata(table, len(names), "planets", None)
+
+
+def _function(name, *args):
+    return {"function": name, "args": list(args)}
+
+
+def _argument(function):
+    column_name = (
+        f"{function['function']}({','.join(str(a[0]) for a in function['args'])})"
+    )
+    return (column_name, TOKEN_TYPES.IDENTIFIER, function)
+
+
+NAME = ("name", TOKEN_TYPES.IDENTIFIER)
+
+
+def test_nested_functions():
+
+    left = _function("LEFT", NAME, (2, TOKEN_TYPES.NUMERIC))
+    upper = _function("UPPER", _argument(left))
+    length = _function("LENGTH", _argument(upper))
+    expressions = Expressions([upper, length, left])
+    # LEFT is only one step, however many times it's used
+    assert len(expressions) == 3, expressions.describe()
+
+    table = _table()
+    results = expressions.evaluate(table, Columns(table))
+    assert results["UPPER(LEFT(name,2))"].to_pylist()[:2] == ["ME", "VE"]
+    assert results["LENGTH(UPPER(LEFT(name,2)))"].to_pylist() == [2] * 7
+
+
+def test_constant_folding():
+
+    lower = _function("LOWER", ("AbC", TOKEN_TYPES.VARCHAR))
+    upper = _function("UPPER", _argument(lower))
+    expressions = Expressions([upper])
+    assert all(step.endswith("(constant)") for step in expressions.describe())
+
+    node = EvaluationNode(
+        QueryDirectives(), QueryStatistics(), projection=[{**upper, "alias": []}]
+    )
+    node.set_producers([_Pages(_table(), 3)])
+    pages = list(node.execute())
+    assert [page.num_rows for page in pages] == [3, 3, 1]
+    values = pyarrow.concat_tables(pages).column("UPPER(LOWER(AbC))").to_pylist()
+    assert values == ["ABC"] * 7, values
+
+
+def test_functions_shared_by_select_and_where():
+
+    calls = []
+
+    def _counter(values):
+        calls.append(len(values))
+        return compute.utf8_length(pyarrow.array(values))
+
+    FUNCTIONS["COUNTED_LENGTH"] = (None, _counter)
+    try:
+        length = _function("COUNTED_LENGTH", NAME)
+        evaluation = EvaluationNode(
+            QueryDirectives(),
+            QueryStatistics(),
+            projection=[{**length, "alias": ["length"]}],
+        )
+        evaluation.set_producers([_Pages(_table(), 3)])
+        selection = SelectionNode(
+            QueryDirectives(),
+            QueryStatistics(),
+            filter=[
+                (_argument(length), ">=", (5, TOKEN_TYPES.NUMERIC)),
+                (_argument(length), "<", (7, TOKEN_TYPES.NUMERIC)),
+            ],
+        )
+        selection.set_producers([evaluation])
+        table = pyarrow.concat_tables(selection.execute())
+        # evaluated once for each page, by the evaluation node
+        assert calls == [3, 3, 1], calls
+        assert table.num_rows == 4, table.num_rows
+
+        # without the evaluation node, the selection evaluates the function
+        calls.clear()
+        selection = SelectionNode(
+            QueryDirectives(),
+            QueryStatistics(),
+            filter=(_argument(length), ">", (0, TOKEN_TYPES.NUMERIC)),
+        )
+        selection.set_producers([_Pages(_table(), 7)])
+        table = pyarrow.concat_tables(selection.execute())
+        assert calls == [7], calls
+        assert table.num_rows == 7
+        assert table.num_columns == 1, table.column_names
+    finally:
+        FUNCTIONS.pop("COUNTED_LENGTH")
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_nested_functions()
+    test_constant_folding()
+    test_functions_shared_by_select_and_where()
+    print("okay")
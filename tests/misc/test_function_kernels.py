@@ -0,0 +1,161 @@
+"""
+The functions which were evaluated a row at a time are evaluated with Arrow compute
+kernels, or once for each distinct value, these tests compare the results to the
+results of evaluating each value individually.
+"""
+import datetime
+import hashlib
+import os
+import sys
+
+import pyarrow
+from cityhash import CityHash64
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine.functions import FUNCTIONS
+from opteryx.third_party.date_trunc import date_trunc
+from opteryx.utils.arrow import map_distinct
+
+STRINGS = pyarrow.array(["Earth", "Mars", None, "Earth", "", "Jupiter"])
+LISTS = pyarrow.array([["a", "b"], [], None, ["c"], ["a", None], ["b", "c", "a"]])
+STRUCTS = pyarrow.array([{"a": 1, "b": "x"}, None, {"a": None, "b": "y"}])
+TIMESTAMPS = pyarrow.array(
+    [
+        datetime.datetime(2022, 2, 16, 13, 45, 12),
+        None,
+        datetime.datetime(1999, 12, 31, 23, 59, 59),
+        datetime.datetime(2022, 1, 2, 0, 0, 1),
+    ],
+    pyarrow.timestamp("us"),
+)
+
+
+def _call(function, *args):
+    return_type, executor = FUNCTIONS[function]
+    result = executor(*args)
+    if return_type is not None:
+        assert result.type == return_type, f"{function} {result.type}"
+    return result.to_pylist()
+
+
+def test_map_distinct():
+
+    calls = []
+
+    def _upper(value):
+        calls.append(value)
+        return None if value is None else value.upper()
+
+    result = map_distinct(_upper, STRINGS, pyarrow.string())
+    assert result.to_pylist() == ["EARTH", "MARS", None, "EARTH", "", "JUPITER"]
+    # each distinct value, including null, is only evaluated once
+    assert len(calls) == 5, calls
+
+
+def test_length():
+
+    assert _call("LENGTH", STRINGS) == [5, 4, None, 5, 0, 7]
+    assert _call("LENGTH", LISTS) == [2, 0, None, 1, 2, 3]
+    assert _call("LEN", STRUCTS) == [2, None, 2]
+
+
+def test_hashes():
+
+    values = STRINGS.to_pylist()
+    assert _call("HASH", STRINGS) == [format(CityHash64(str(v)), "X") for v in values]
+    assert _call("MD5", STRINGS) == [
+        hashlib.md5(str(v).encode()).hexdigest() for v in values  # nosec
+    ]
+
+
+def test_get():
+
+    assert _call("GET", LISTS, 1) == ["b", None, None, None, None, "c"]
+    assert _call("GET", STRUCTS, "b") == ["x", None, "y"]
+    assert _call("GET", STRINGS, 2) == ["r", "r", None, "r", None, "p"]
+
+
+def test_list_contains():
+
+    # null lists don't contain anything
+    assert _call("LIST_CONTAINS", LISTS, "a") == [True, False, False, False, True, True]
+    assert _call("LIST_CONTAINS_ANY", LISTS, ("c", "z")) == [
+        False,
+        False,
+        False,
+        True,
+        False,
+        True,
+    ]
+    assert _call("LIST_CONTAINS_ALL", LISTS, ("a", "b")) == [
+        True,
+        False,
+        False,
+        False,
+        False,
+        True,
+    ]
+
+
+def test_list_contains_types():
+
+    # values are only matched by items of the same kind
+    numbers = pyarrow.array([[1, 2], [3], None])
+    assert _call("LIST_CONTAINS", numbers, 2) == [True, False, False]
+    assert _call("LIST_CONTAINS", numbers, "2") == [False, False, False]
+    assert _call("LIST_CONTAINS_ANY", numbers, ("2",)) == [False, False, False]
+    assert _call("LIST_CONTAINS_ANY", numbers, (2.0, 3)) == [True, True, False]
+    assert _call("LIST_CONTAINS_ALL", numbers, ("1", "2")) == [False, False, False]
+    assert _call("LIST_CONTAINS_ANY", LISTS, (1,)) == [False] * 6
+
+
+def test_try_casts():
+
+    numbers = pyarrow.array(["1.5", "one", None, "2"])
+    assert _call("TRY_NUMERIC", numbers) == [1.5, None, None, 2.0]
+    assert _call("TRY_VARCHAR", pyarrow.array([1, None])) == ["1", None]
+    assert _call("TRY_TIMESTAMP", pyarrow.array(["2022-01-02", "never"])) == [
+        datetime.datetime(2022, 1, 2),
+        None,
+    ]
+
+    # the result for a value doesn't depend on the other values on the page
+    assert _call("TRY_BOOLEAN", pyarrow.array(["false", "true"])) == [False, True]
+    assert _call("TRY_BOOLEAN", pyarrow.array(["false", "true", "x", None])) == [
+        False,
+        True,
+        None,
+        None,
+    ]
+    mixed = pyarrow.array(["2", "2.50", "two"])
+    assert _call("TRY_NUMERIC", mixed) == [2.0, 2.5, None]
+    assert _call("TRY_VARCHAR", pyarrow.array([2.0, 1.5])) == ["2", "1.5"]
+
+
+def test_dates():
+
+    expected = [
+        None if value is None else datetime.datetime.combine(value, datetime.time())
+        for value in TIMESTAMPS.to_pylist()
+    ]
+    assert _call("DATE", TIMESTAMPS) == expected
+
+    for unit in ("second", "minute", "hour", "day", "week", "month", "year"):
+        expected = [
+            None if value is None else date_trunc(unit, value)
+            for value in TIMESTAMPS.to_pylist()
+        ]
+        assert _call("DATE_TRUNC", unit, TIMESTAMPS) == expected, unit
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_map_distinct()
+    test_length()
+    test_hashes()
+    test_get()
+    test_list_contains()
+    test_list_contains_types()
+    test_try_casts()
+    test_dates()
+    print("okay")
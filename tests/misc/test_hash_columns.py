@@ -0,0 +1,58 @@
+"""
+The hashes of the group keys are used to partition aggregation states, rows with the
+same values must be in the same partition, regardless of the page they came from.
+"""
+import os
+import sys
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.utils.arrow import hash_columns, partition_table
+
+
+def test_equal_values_have_equal_hashes():
+
+    table = pyarrow.Table.from_pydict(
+        {
+            "number": [1, 2, 1, None, None],
+            "string": ["a", "b", "a", None, None],
+            "float": [0.0, 1.5, -0.0, float("nan"), float("nan")],
+            "boolean": [True, False, True, None, None],
+        }
+    )
+    hashes = hash_columns(table, table.column_names)
+    assert len(hashes) == 5
+    assert hashes[0] == hashes[2], hashes
+    assert hashes[3] == hashes[4], hashes
+    assert hashes[0] != hashes[1], hashes
+
+
+def test_hashes_are_independent_of_pages():
+
+    table = pyarrow.Table.from_pydict({"string": ["a", "b", "c", "a", "b", "c"]})
+    first = hash_columns(table.slice(0, 3), ["string"])
+    second = hash_columns(table.slice(3, 3), ["string"])
+    assert list(first) == list(second)
+
+
+def test_partition_table():
+
+    table = pyarrow.Table.from_pydict({"key": list(range(100)) * 3})
+    partitions = partition_table(table, ["key"], 4)
+    assert len(partitions) == 4
+    assert sum(p.num_rows for p in partitions) == 300
+    seen = set()
+    for partition in partitions:
+        keys = set(partition.column("key").to_pylist())
+        assert seen.isdisjoint(keys)
+        seen.update(keys)
+    assert partition_table(table, [], 4) == [table]
+
+
+if __name__ == "__main__":  # pragma: no cover
+
+    test_equal_values_have_equal_hashes()
+    test_hashes_are_independent_of_pages()
+    test_partition_table()
+    print("okay")
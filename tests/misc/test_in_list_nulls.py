@@ -0,0 +1,64 @@
+"""
+x IN (...) is unknown (null) when x is null, or when x isn't in the list and the
+list contains a null, and NOT IN is the negation of IN. Lists which can't be built
+into an array (e.g. the values are of mixed types) or compared natively with the
+column are evaluated in Python, these must follow the same rules.
+"""
+import datetime
+import os
+import sys
+
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine.attribute_types import TOKEN_TYPES
+from opteryx.engine.planner.operations import selection_node
+
+TABLE = pyarrow.table(
+    {
+        "x": pyarrow.array([1, 2, None, 3]),
+        "d": pyarrow.array(
+            [datetime.date(2022, 1, 1), None, datetime.date(2022, 1, 2), None]
+        ),
+    }
+)
+
+
+def _predicate(column, operator, values):
+    return ((column, TOKEN_TYPES.IDENTIFIER), operator, (values, TOKEN_TYPES.LIST))
+
+
+def _select(column, operator, values):
+    return selection_node._evaluate(
+        _predicate(column, operator, values), TABLE
+    ).to_pylist()
+
+
+def test_in_mixed_list():
+
+    # the list can't be built into an array
+    assert _select("x", "in", {3, "a"}) == [False, False, None, True]
+    assert _select("x", "not in", {3, "a"}) == [True, True, None, False]
+
+    assert _select("x", "in", {1, "a", None}) == [True, None, None, None]
+    assert _select("x", "not in", {1, "a", None}) == [False, None, None, None]
+
+
+def test_in_list_not_comparable():
+
+    # integers can't be cast to dates, or dates to integers
+    values = pyarrow.array([1, None])
+    assert selection_node._in_list(TABLE, _predicate("d", "in", values)) is None
+    assert _select("d", "in", values) == [None, None, None, None]
+    assert _select("d", "not in", values) == [None, None, None, None]
+
+    values = pyarrow.array([1, 2])
+    assert _select("d", "in", values) == [False, None, False, None]
+    assert _select("d", "not in", values) == [True, None, True, None]
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_in_mixed_list()
+    test_in_list_not_comparable()
+    print("okay")
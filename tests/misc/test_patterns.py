@@ -0,0 +1,94 @@
+"""
+LIKE, ILIKE and regular expression patterns which are a literal with wildcards at
+the ends are matched with the prefix, suffix and substring kernels rather than as a
+regular expression, the results must be the same as matching the regular expression.
+"""
+import os
+import sys
+
+import pyarrow
+from pyarrow import compute
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.utils import patterns
+
+VALUES = pyarrow.array(
+    ["abc", "ABC", "xabcx", "abcabc", "", None, "a%c", "a_c", "Ünïcödé", "ab\nc"]
+)
+
+LIKE_PATTERNS = [
+    "abc",
+    "abc%",
+    "%abc",
+    "%abc%",
+    "%",
+    "%%",
+    "",
+    "a_c",
+    "a%c",
+    "%b%c",
+    "%ÏC%",
+    "ünï%",
+    "a\\%c",
+]
+
+REGEX_PATTERNS = ["abc", "^abc", "abc$", "^abc$", "^$", "", "a.c", "^a|c$", "ï"]
+
+
+def test_like_patterns():
+    for pattern in LIKE_PATTERNS:
+        for ignore_case in (False, True):
+            expected = compute.match_like(VALUES, pattern, ignore_case=ignore_case)
+            matches = patterns.compile_like(pattern, ignore_case)(VALUES)
+            assert matches.to_pylist() == expected.to_pylist(), (pattern, ignore_case)
+
+
+def test_regex_patterns():
+    for pattern in REGEX_PATTERNS:
+        expected = compute.match_substring_regex(VALUES, pattern)
+        matches = patterns.compile_regex(pattern)(VALUES)
+        assert matches.to_pylist() == expected.to_pylist(), pattern
+
+
+def test_any_patterns():
+    pattern_sets = [
+        ("abc%", "%c"),
+        ("%ÏC%", "x%"),
+        ("a\\%c", "a\\_c"),
+        ("a_c", "%.%"),
+        ("(x)", "%b%"),
+        ("%", "zz"),
+        ("", "a%c"),
+    ]
+    for pattern_set in pattern_sets:
+        for operator in ("like", "ilike"):
+            expected = None
+            for pattern in pattern_set:
+                matches = compute.match_like(
+                    VALUES, pattern, ignore_case=operator == "ilike"
+                )
+                expected = (
+                    matches
+                    if expected is None
+                    else compute.or_kleene(expected, matches)
+                )
+            matches = patterns.match_any(VALUES, operator, pattern_set)
+            assert matches.to_pylist() == expected.to_pylist(), (pattern_set, operator)
+
+
+def test_pattern_classification():
+    assert patterns._classify_like("abc%") == ("starts_with", "abc")
+    assert patterns._classify_like("%abc") == ("ends_with", "abc")
+    assert patterns._classify_like("%abc%") == ("contains", "abc")
+    assert patterns._classify_like("a_c%") is None
+    assert patterns._classify_regex("^abc") == ("starts_with", "abc")
+    assert patterns._classify_regex("a.c") is None
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_like_patterns()
+    test_regex_patterns()
+    test_any_patterns()
+    test_pattern_classification()
+    print("okay")
@@ -0,0 +1,76 @@
+"""
+MEDIAN, PERCENTILE_CONT and PERCENTILE_DISC select the values for all of the groups
+at once, the results must be the same as selecting from each group's sorted values,
+ignoring nulls and NaNs, and empty groups are null. Floating point values are
+selected by partitioning when the groups are large, other values are sorted.
+"""
+import math
+import os
+import sys
+
+import numpy
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine.planner.operations import aggregate_node
+from opteryx.engine.planner.operations.aggregate_node import _percentile
+
+
+def _expected(values, fraction, interpolate):
+    values = sorted(v for v in values or [] if v is not None and v == v)
+    if len(values) == 0:
+        return None
+    if interpolate:
+        return float(numpy.percentile(values, fraction * 100))
+    return values[max(math.ceil(fraction * len(values)) - 1, 0)]
+
+
+def test_percentiles_by_group():
+
+    random = numpy.random.default_rng(3)
+    groups = []
+    for _ in range(500):
+        values = [float(v) for v in random.integers(0, 50, random.integers(0, 12))]
+        if values and random.random() < 0.3:
+            values[0] = None
+        if values and random.random() < 0.3:
+            values[-1] = float("nan")
+        groups.append(values if random.random() > 0.05 else None)
+    lists = pyarrow.array(groups, pyarrow.list_(pyarrow.float64()))
+    strings = pyarrow.array(
+        [[str(v) for v in g if v is not None and v == v] if g else g for g in groups]
+    )
+
+    floats = lists.cast(pyarrow.list_(pyarrow.float32()))
+
+    partition_group_size = aggregate_node.PARTITION_GROUP_SIZE
+    try:
+        # always partition, then always sort
+        for aggregate_node.PARTITION_GROUP_SIZE in (0, len(groups) * 100):
+            for fraction in (0.0, 0.25, 0.5, 0.9, 1.0):
+                results = _percentile(fraction, True)([lists]).to_pylist()
+                for result, group in zip(results, groups):
+                    expected = _expected(group, fraction, True)
+                    assert (result is None and expected is None) or math.isclose(
+                        result, expected
+                    ), (fraction, group, result)
+
+                expected = [_expected(g, fraction, False) for g in groups]
+                results = _percentile(fraction, False)([lists]).to_pylist()
+                assert results == expected, fraction
+                result = _percentile(fraction, False)([floats])
+                assert result.type == pyarrow.float32()
+                assert result.to_pylist() == expected, fraction
+
+                # PERCENTILE_DISC works on values which can be sorted, not just numbers
+                results = _percentile(fraction, False)([strings]).to_pylist()
+                expected = [_expected(g, fraction, False) for g in strings.to_pylist()]
+                assert results == expected, fraction
+    finally:
+        aggregate_node.PARTITION_GROUP_SIZE = partition_group_size
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_percentiles_by_group()
+    print("okay")
@@ -0,0 +1,120 @@
+"""
+The predicates in an AND list are reordered using their observed cost and
+selectivity, and later predicates are only evaluated on the rows which haven't been
+eliminated. The rows selected must be the same as evaluating the predicates in the
+order they were written, including when the AND is inside a NOT, where rows with an
+unknown result matter.
+"""
+import os
+import sys
+
+import numpy
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine import QueryDirectives, QueryStatistics
+from opteryx.engine.attribute_types import TOKEN_TYPES
+from opteryx.engine.planner.operations import selection_node
+from opteryx.utils.columns import Columns
+
+
+class _Pages:
+    def __init__(self, table, size):
+        self.table = table
+        self.size = size
+
+    def execute(self):
+        for start in range(0, self.table.num_rows, self.size):
+            yield self.table.slice(start, self.size)
+
+
+def _table(rows):
+    random = numpy.random.default_rng(1)
+    a = random.integers(0, 10, rows).astype(float)
+    a[random.random(rows) < 0.1] = numpy.nan
+    b = pyarrow.array(random.integers(0, 100, rows), mask=random.random(rows) < 0.2)
+    table = pyarrow.table({"a": pyarrow.array(a, from_pandas=True), "b": b})
+    return Columns.create_table_metadata(table, rows, "t", None)
+
+
+def _condition(column, operator, value):
+    return ((column, TOKEN_TYPES.IDENTIFIER), operator, (value, TOKEN_TYPES.NUMERIC))
+
+
+def _select(table, predicate, page_size):
+    node = selection_node.SelectionNode(
+        QueryDirectives(), QueryStatistics(), filter=predicate
+    )
+    node.set_producers([_Pages(table, page_size)])
+    return pyarrow.concat_tables(node.execute()).num_rows
+
+
+def test_selection_order():
+
+    table = _table(300000)
+    conjunction = [_condition("a", "=", 3.0), _condition("b", ">", 50.0)]
+    negated = ("Not", ([_condition("a", "=", 3.0), _condition("b", ">", 95.0)],))
+
+    expected = sum(
+        1 for a, b in zip(*_columns(table)) if a == 3.0 and b is not None and b > 50
+    )
+    for page_size in (300000, 40000):
+        assert _select(table, conjunction, page_size) == expected
+
+    # NOT (a = 3 AND b > 95) is only true when one of the conditions is false
+    expected = sum(
+        1
+        for a, b in zip(*_columns(table))
+        if (a is not None and a != 3.0) or (b is not None and b <= 95)
+    )
+    for page_size in (300000, 40000):
+        assert _select(table, negated, page_size) == expected
+
+
+def _columns(table):
+    a = [
+        None if value is None or value != value else value
+        for value in table.column(0).to_pylist()
+    ]
+    return a, table.column(1).to_pylist()
+
+
+def test_conjunction_with_function():
+
+    # the function's arguments refer to the column by its alias, so the column must
+    # still be there when the function is evaluated on the remaining rows
+    rows = 300000
+    names = numpy.array(["Earth", "Mars", "Venus"])[numpy.arange(rows) % 3]
+    table = pyarrow.table({"a": numpy.arange(rows) % 10, "name": names})
+    table = Columns.create_table_metadata(table, rows, "t", None)
+    function = {
+        "function": "SEARCH",
+        "args": [("name", TOKEN_TYPES.IDENTIFIER), ("ar", TOKEN_TYPES.VARCHAR)],
+    }
+    conjunction = [
+        _condition("a", "=", 3),
+        ("SEARCH(name,ar)", TOKEN_TYPES.IDENTIFIER, function),
+    ]
+    expected = sum(1 for i in range(rows) if i % 10 == 3 and i % 3 != 2)
+    for page_size in (300000, 40000):
+        assert _select(table, conjunction, page_size) == expected
+
+
+def test_conjunction_order():
+
+    order = selection_node.ConjunctionOrder(3)
+    # cheap and eliminates most rows
+    order.record(0, 1000, 500, 1000)
+    order.record(1, 1000, 10, 1000)
+    # expensive and eliminates few rows
+    order.record(2, 1000, 900, 100000)
+    assert order.order() == [1, 0, 2]
+    assert order.selectivity(1) == 0.01
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_selection_order()
+    test_conjunction_with_function()
+    test_conjunction_order()
+    print("okay")
@@ -0,0 +1,114 @@
+"""
+When the data being sorted exceeds MAX_OPERATOR_MEMORY, it's sorted in runs which
+are written to disk and then merged. The order must be the same as sorting all of
+the data at once, including directions, NaNs and nulls, and columns added to sort
+by functions which aren't in the SELECT clause must be removed.
+"""
+import os
+import sys
+
+import numpy
+import pyarrow
+import pyarrow.compute
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine import QueryDirectives, QueryStatistics
+from opteryx.engine.attribute_types import TOKEN_TYPES
+from opteryx.engine.planner.operations import sort_node
+from opteryx.utils.columns import Columns
+
+
+class _Pages:
+    def __init__(self, table, size):
+        self.table = table
+        self.size = size
+
+    def execute(self):
+        for start in range(0, self.table.num_rows, self.size):
+            yield self.table.slice(start, self.size)
+
+
+def _table(rows):
+    random = numpy.random.default_rng(11)
+    floats = random.choice([1.5, -2.0, 0.0, numpy.nan, numpy.inf, -1.0], rows)
+    return pyarrow.table(
+        {
+            "id": numpy.arange(rows),
+            "a": pyarrow.array(
+                random.integers(0, 20, rows), mask=random.random(rows) < 0.1
+            ),
+            "f": pyarrow.array(floats, mask=random.random(rows) < 0.1),
+            "s": pyarrow.array(
+                random.integers(0, 1000, rows).astype(str),
+                mask=random.random(rows) < 0.1,
+            ),
+        }
+    )
+
+
+def _sort(table, order):
+    statistics = QueryStatistics()
+    table = Columns.create_table_metadata(table, table.num_rows, "t", None)
+    memory = sort_node.MAX_OPERATOR_MEMORY
+    run_batch_rows = sort_node.RUN_BATCH_ROWS
+    # each page is a run, and the runs are read back a few rows at a time
+    sort_node.MAX_OPERATOR_MEMORY = 1
+    sort_node.RUN_BATCH_ROWS = 97
+    try:
+        node = sort_node.SortNode(QueryDirectives(), statistics, order=order)
+        node.set_producers([_Pages(table, 500)])
+        result = pyarrow.concat_tables(node.execute())
+    finally:
+        sort_node.MAX_OPERATOR_MEMORY = memory
+        sort_node.RUN_BATCH_ROWS = run_batch_rows
+
+    assert statistics.spills == 10, statistics.spills
+    columns = Columns(result)
+    return result.rename_columns(
+        [columns.get_preferred_name(column) for column in result.column_names]
+    )
+
+
+def test_external_sort():
+
+    table = _table(5000)
+    for order in (
+        [("f", "ascending")],
+        [("f", "descending")],
+        [("a", "ascending"), ("f", "descending"), ("s", "ascending")],
+        [("s", "descending"), ("a", "descending")],
+    ):
+        result = _sort(table, order)
+        assert result.column_names == table.column_names
+        expected = table.sort_by(order)
+        assert result["id"].to_pylist() == expected["id"].to_pylist(), order
+
+
+def test_external_sort_by_functions():
+
+    table = _table(5000)
+    length = {
+        "function": "LENGTH",
+        "args": [("s", TOKEN_TYPES.IDENTIFIER)],
+        "alias": "LENGTH(s)",
+    }
+    result = _sort(table, [(length, "descending"), ("a", "ascending")])
+    # the function was evaluated to sort by, but isn't returned
+    assert result.column_names == table.column_names
+    expected = table.append_column(
+        "length", pyarrow.compute.utf8_length(table["s"])
+    ).sort_by([("length", "descending"), ("a", "ascending")])
+    assert result["id"].to_pylist() == expected["id"].to_pylist()
+
+    random = {"function": "RANDOM", "args": [], "alias": "RANDOM()"}
+    result = _sort(table, [(random, "ascending")])
+    assert result.column_names == table.column_names
+    assert sorted(result["id"].to_pylist()) == table["id"].to_pylist()
+    assert result["id"].to_pylist() != table["id"].to_pylist()
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_external_sort()
+    test_external_sort_by_functions()
+    print("okay")
@@ -0,0 +1,78 @@
+"""
+Large tables are sorted in parallel using normalized keys, the order must be the
+same as pyarrow's stable sort, including directions, NaNs and nulls.
+"""
+import os
+import sys
+import numpy
+import pyarrow
+import pyarrow.compute
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.utils import sorting
+
+
+def _table():
+    generator = numpy.random.default_rng(42)
+    rows = 5000
+    floats = generator.choice([1.5, -2.0, 0.0, -0.0, numpy.nan, numpy.inf, -1.0], rows)
+    return pyarrow.Table.from_pydict(
+        {
+            "integer": pyarrow.array(
+                generator.integers(-50, 50, rows), mask=generator.random(rows) < 0.1
+            ),
+            "float": pyarrow.array(floats, mask=generator.random(rows) < 0.1),
+            "string": pyarrow.array(
+                generator.integers(0, 100, rows).astype(str),
+                mask=generator.random(rows) < 0.1,
+            ),
+            "date": pyarrow.array(generator.integers(0, 1000, rows).astype("M8[D]")),
+            "boolean": pyarrow.array(generator.random(rows) < 0.5),
+        }
+    )
+
+
+def test_parallel_sort_matches_pyarrow():
+
+    sorting.PARALLEL_SORT_ROWS = 10
+    table = _table()
+
+    for order in (
+        [("float", "ascending")],
+        [("float", "descending")],
+        [("integer", "ascending"), ("string", "descending")],
+        [("date", "descending"), ("boolean", "ascending"), ("integer", "descending")],
+    ):
+        indices = sorting.sort_indices(table, order, threads=3)
+        assert indices is not None, order
+        expected = pyarrow.compute.sort_indices(table, sort_keys=order)
+        assert list(indices) == expected.to_pylist(), order
+
+
+def test_unencodable_keys_fall_back():
+
+    sorting.PARALLEL_SORT_ROWS = 10
+    table = _table()
+
+    # a float needs all 64 bits, so can't be combined with another column
+    order = [("string", "ascending"), ("float", "ascending")]
+    assert sorting.sort_indices(table, order, threads=3) is None
+    assert sorting.sort_table(table, order)["integer"].equals(
+        table.sort_by(order)["integer"]
+    )
+
+    # a column with one value doesn't use any bits, but still can't go before a float
+    table = table.append_column("constant", pyarrow.array(["x"] * table.num_rows))
+    order = [("constant", "ascending"), ("float", "descending")]
+    assert sorting.normalized_keys(table, order) is None
+    assert sorting.sort_table(table, order)["integer"].equals(
+        table.sort_by(order)["integer"]
+    )
+
+
+if __name__ == "__main__":  # pragma: no cover
+
+    test_parallel_sort_matches_pyarrow()
+    test_unencodable_keys_fall_back()
+    print("okay")
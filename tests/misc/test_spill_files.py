@@ -0,0 +1,51 @@
+"""
+Spill files hold intermediate data for operators which have exceeded their memory
+budget, the data must be returned intact and the files removed when done.
+"""
+import os
+import sys
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.utils.spill import SpillFiles
+
+
+def test_spill_round_trip():
+
+    table = pyarrow.Table.from_pydict({"key": [1, 2, 3], "value": ["a", "b", "c"]})
+
+    with SpillFiles(partitions=2) as spill:
+        folder = spill._folder
+        spill.write(0, table)
+        spill.write(0, table.slice(0, 1))
+        assert spill.bytes_written > 0
+
+        partition = spill.read(0)
+        assert partition.num_rows == 4, partition.num_rows
+        assert partition.column("value").to_pylist() == ["a", "b", "c", "a"]
+        # nothing was written to this partition
+        assert spill.read(1) is None
+
+    assert not os.path.exists(folder)
+
+
+def test_spill_stream():
+
+    table = pyarrow.Table.from_pydict({"key": list(range(10))})
+
+    with SpillFiles() as spill:
+        spill.write(3, table, max_chunksize=4)
+        batches = list(spill.stream(3))
+        assert [b.num_rows for b in batches] == [4, 4, 2], batches
+        assert pyarrow.concat_tables(batches).column("key").to_pylist() == list(
+            range(10)
+        )
+        assert list(spill.stream(0)) == []
+
+
+if __name__ == "__main__":  # pragma: no cover
+
+    test_spill_round_trip()
+    test_spill_stream()
+    print("okay")
@@ -0,0 +1,82 @@
+"""
+The columns only referenced in the WHERE clause are dropped by the Selection Node
+before the rows are selected, the rows selected must be the same, and at least one
+column is kept so the rows can still be counted.
+"""
+import os
+import sys
+
+import numpy
+import pyarrow
+
+sys.path.insert(1, os.path.join(sys.path[0], "../.."))
+
+from opteryx.engine import QueryDirectives, QueryStatistics
+from opteryx.engine.attribute_types import TOKEN_TYPES
+from opteryx.engine.planner.operations import SelectionNode
+from opteryx.utils.columns import Columns
+
+
+class _Pages:
+    def __init__(self, table, size):
+        self.table = table
+        self.size = size
+
+    def execute(self):
+        for start in range(0, self.table.num_rows, self.size):
+            yield self.table.slice(start, self.size)
+
+
+def _table():
+    random = numpy.random.default_rng(1)
+    table = pyarrow.table(
+        {
+            "a": random.integers(0, 10, 1000),
+            "b": random.integers(0, 10, 1000),
+            "c": random.integers(0, 10, 1000),
+        }
+    )
+    return Columns.create_table_metadata(table, table.num_rows, "t", None)
+
+
+def _select(table, predicate, unused):
+    node = SelectionNode(
+        QueryDirectives(), QueryStatistics(), filter=predicate, unused=unused
+    )
+    node.set_producers([_Pages(table, 300)])
+    result = pyarrow.concat_tables(node.execute())
+    columns = Columns(result)
+    return result.rename_columns(
+        [columns.get_preferred_name(column) for column in result.column_names]
+    )
+
+
+def test_unused_columns_are_dropped():
+
+    table = _table()
+    predicate = [
+        (("b", TOKEN_TYPES.IDENTIFIER), ">", (4, TOKEN_TYPES.NUMERIC)),
+        (("c", TOKEN_TYPES.IDENTIFIER), "=", (3, TOKEN_TYPES.NUMERIC)),
+    ]
+    expected = _select(table, predicate, None)
+    assert expected.column_names == ["a", "b", "c"]
+
+    result = _select(table, predicate, {"b", "c"})
+    assert result.column_names == ["a"], result.column_names
+    assert result.column("a").to_pylist() == expected.column("a").to_pylist()
+
+    # all of the columns are unused, e.g. SELECT COUNT(*)
+    result = _select(table, predicate, {"a", "b", "c"})
+    assert result.num_columns == 1
+    assert result.num_rows == expected.num_rows
+
+    # all of the rows are selected
+    predicate = (("a", TOKEN_TYPES.IDENTIFIER), ">=", (0, TOKEN_TYPES.NUMERIC))
+    result = _select(table, predicate, {"b"})
+    assert result.column_names == ["a", "c"]
+    assert result.num_rows == 1000
+
+
+if __name__ == "__main__":  # pragma: no cover
+    test_unused_columns_are_dropped()
+    print("okay")
@@ -23,22 +23,43 @@ STATEMENTS = [
         # arrow (feather)
         ("SELECT * FROM tests.data.formats.arrow WITH(NO_PARTITION)", 100000, 13),
         ("SELECT user_name, user_verified FROM tests.data.formats.arrow WITH(NO_PARTITION) WHERE user_name ILIKE '%news%'", 122, 2),
+        ("SELECT * FROM tests.data.formats.arrow WITH(NO_PARTITION) LIMIT 10", 10, 13),
+        ("SELECT user_name FROM tests.data.formats.arrow WITH(NO_PARTITION) LIMIT 10 OFFSET 99995", 5, 1),
 
         # jsonl
         ("SELECT * FROM tests.data.formats.jsonl WITH(NO_PARTITION)", 100000, 13),
         ("SELECT user_name, user_verified FROM tests.data.formats.jsonl WITH(NO_PARTITION) WHERE user_name ILIKE '%news%'", 122, 2),
+        ("SELECT * FROM tests.data.formats.jsonl WITH(NO_PARTITION) LIMIT 10", 10, 13),
+        ("SELECT user_name FROM tests.data.formats.jsonl WITH(NO_PARTITION) LIMIT 10 OFFSET 99995", 5, 1),
 
         # orc
         ("SELECT * FROM tests.data.formats.orc WITH(NO_PARTITION)", 100000, 13),
         ("SELECT user_name, user_verified FROM tests.data.formats.orc WITH(NO_PARTITION) WHERE user_name ILIKE '%news%'", 122, 2),
+        ("SELECT * FROM tests.data.formats.orc WITH(NO_PARTITION) LIMIT 10", 10, 13),
+        ("SELECT user_name FROM tests.data.formats.orc WITH(NO_PARTITION) LIMIT 10 OFFSET 99995", 5, 1),
+        ("SELECT user_name FROM tests.data.formats.orc WITH(NO_PARTITION) WHERE followers > 100000 AND user_verified = TRUE", 156, 1),
+        ("SELECT user_name FROM tests.data.formats.orc WITH(NO_PARTITION) WHERE followers > 100000 OR user_verified = TRUE", 910, 1),
+        ("SELECT COUNT(*) FROM tests.data.formats.orc WITH(NO_PARTITION)", 1, 1),
 
         # parquet
         ("SELECT * FROM tests.data.formats.parquet WITH(NO_PARTITION)", 100000, 13),
         ("SELECT user_name, user_verified FROM tests.data.formats.parquet WITH(NO_PARTITION) WHERE user_name ILIKE '%news%'", 122, 2),
+        ("SELECT * FROM tests.data.formats.parquet WITH(NO_PARTITION) LIMIT 10", 10, 13),
+        ("SELECT user_name FROM tests.data.formats.parquet WITH(NO_PARTITION) LIMIT 10 OFFSET 99995", 5, 1),
+        ("SELECT user_name FROM tests.data.formats.parquet WITH(NO_PARTITION) WHERE followers > 100000 AND user_verified = TRUE", 156, 1),
+        ("SELECT user_name FROM tests.data.formats.parquet WITH(NO_PARTITION) WHERE followers > 100000 OR user_verified = TRUE", 910, 1),
+        ("SELECT COUNT(*), MIN(tweet_id), MAX(followers), COUNT(is_quoting) FROM tests.data.formats.parquet WITH(NO_PARTITION)", 1, 4),
+        ("SELECT MAX(user_name) FROM tests.data.formats.parquet WITH(NO_PARTITION)", 1, 1),
+        ("SELECT user_name AS name FROM tests.data.formats.parquet WITH(NO_PARTITION) ORDER BY followers DESC LIMIT 5", 5, 1),
+        ("SELECT user_name FROM tests.data.formats.parquet WITH(NO_PARTITION) WHERE user_verified = TRUE AND user_name ILIKE '%news%'", 18, 1),
+        ("SELECT p.* FROM tests.data.formats.parquet AS p WITH(NO_PARTITION) WHERE followers > 100000 AND user_verified = TRUE", 156, 13),
+        ("SELECT p.user_name FROM tests.data.formats.parquet AS p WITH(NO_PARTITION) INNER JOIN tests.data.formats.arrow AS a WITH(NO_PARTITION) USING (tweet_id)", 100000, 1),
 
         # zstandard jsonl
         ("SELECT * FROM tests.data.formats.zstd WITH(NO_PARTITION)", 100000, 13),
         ("SELECT user_name, user_verified FROM tests.data.formats.zstd WITH(NO_PARTITION) WHERE user_name ILIKE '%news%'", 122, 2),
+        ("SELECT * FROM tests.data.formats.zstd WITH(NO_PARTITION) LIMIT 10", 10, 13),
+        ("SELECT user_name FROM tests.data.formats.zstd WITH(NO_PARTITION) LIMIT 10 OFFSET 99995", 5, 1),
     ]
 # fmt:on
 
@@ -105,6 +105,13 @@ STATEMENTS = [
         ("SELECT * FROM $satellites WHERE (id IN (5,6,7,8)) AND name = 'Europa'", 1, 8),
         ("SELECT * FROM $satellites WHERE (id IN (5,6,7,8) AND name = 'Europa')", 1, 8),
         ("SELECT * FROM $satellites WHERE id IN (5,6,7,8) OR name = 'Moon'", 5, 8),
+        ("SELECT * FROM $satellites WHERE planetId IN (5, 6)", 128, 8),
+        ("SELECT * FROM $satellites WHERE planetId NOT IN (5, 6)", 49, 8),
+        ("SELECT * FROM $satellites WHERE planetId NOT IN (5, 6, NULL)", 0, 8),
+        ("SELECT * FROM $astronauts WHERE `year` NOT IN (1996, 'a')", 295, 19),
+        ("SELECT * FROM $astronauts WHERE `year` IN (1996, 'a', NULL)", 35, 19),
+        ("SELECT * FROM $astronauts WHERE `year` NOT IN (1996, 'a', NULL)", 0, 19),
+        ("SELECT * FROM $satellites WHERE name IN ('Moon', 'Europa', 'Pluto')", 2, 8),
         ("SELECT * FROM $satellites WHERE (id = 5 OR id = 6 OR id = 7 OR id = 8) AND name = 'Europa'", 1, 8),
         ("SELECT * FROM $satellites WHERE (id = 6 OR id = 7 OR id = 8) OR name = 'Europa'", 4, 8),
         ("SELECT * FROM $satellites WHERE id = 5 OR id = 6 OR id = 7 OR id = 8 OR name = 'Moon'", 5, 8),
@@ -140,6 +147,7 @@ STATEMENTS = [
         ("SELECT COUNT(*), planetId FROM $satellites WHERE name LIKE 'Cal%' GROUP BY planetId", 3, 2),
         
         ("SELECT DISTINCT planetId FROM $satellites", 7, 1),
+        ("SELECT DISTINCT ON (planetId) planetId, name FROM $satellites", 7, 2),
         ("SELECT * FROM $satellites LIMIT 50", 50, 8),
         ("SELECT * FROM $satellites LIMIT 0", 0, 8),
         ("SELECT * FROM $satellites OFFSET 150", 27, 8),
@@ -161,6 +169,12 @@ STATEMENTS = [
         ("SELECT SUM(id), planetId FROM $satellites GROUP BY planetId", 7, 2),
         ("SELECT MIN(id), MAX(id), SUM(planetId), planetId FROM $satellites GROUP BY planetId", 7, 4),
         ("SELECT planetId, LIST(name) FROM $satellites GROUP BY planetId", 7, 2),
+        ("SELECT AVG(gm), MEDIAN(gm), PRODUCT(radius), planetId FROM $satellites GROUP BY planetId", 7, 4),
+        ("SELECT FIRST(name), LAST(name), STDDEV_POP(gm), VAR_POP(gm), planetId FROM $satellites GROUP BY planetId", 7, 5),
+        ("SELECT AVG(gm), MEDIAN(gm), LIST(name) FROM $satellites", 1, 3),
+        ("SELECT PERCENTILE_CONT(gm, 0.9), PERCENTILE_DISC(gm, 0.9) FROM $satellites", 1, 2),
+        ("SELECT MEDIAN(gm), PERCENTILE_DISC(name, 0.5), planetId FROM $satellites GROUP BY planetId", 7, 3),
+        ("SELECT COUNT(*), name FROM $satellites GROUP BY name", 177, 2),
 
         ("SELECT BOOLEAN(planetId) FROM $satellites GROUP BY planetId, BOOLEAN(planetId)", 7, 1),
         ("SELECT VARCHAR(planetId) FROM $satellites GROUP BY planetId, VARCHAR(planetId)", 7, 1),
@@ -241,6 +255,14 @@ STATEMENTS = [
         ("SELECT count(*), VARCHAR(year) FROM $astronauts GROUP BY VARCHAR(year)", 21, 2),
         ("SELECT count(*), CAST(year AS VARCHAR) FROM $astronauts GROUP BY CAST(year AS VARCHAR)", 21, 2),
 
+        ("SELECT UPPER(LEFT(name, 2)) FROM $planets", 9, 1),
+        ("SELECT UPPER('a') FROM $planets", 9, 1),
+        ("SELECT name FROM $satellites WHERE LENGTH(name) > 6 ORDER BY LENGTH(name)", 107, 1),
+        ("SELECT COUNT(*) FROM $satellites GROUP BY LEFT(name, 1)", 21, 1),
+        ("SELECT MAX(LENGTH(name)) FROM $satellites", 1, 1),
+        ("SELECT name FROM $satellites WHERE planetId = 5 AND gm > 1", 4, 1),
+        ("SELECT COUNT(*) FROM $satellites WHERE planetId = 5", 1, 1),
+
         ("SELECT RANDOM()", 1, 1),
         ("SELECT NOW()", 1, 1),
         ("SELECT NOW() from $planets", 9, 1),
@@ -305,6 +327,13 @@ STATEMENTS = [
 
         ("SELECT * FROM $astronauts WHERE death_date IS NULL", 305, 19),
         ("SELECT * FROM $astronauts WHERE death_date IS NOT NULL", 52, 19),
+        # NOT and OR of unknown (null) conditions are unknown
+        ("SELECT * FROM $astronauts WHERE NOT `year` > 1990", 195, 19),
+        ("SELECT * FROM $astronauts WHERE `year` > 1990 OR NOT `year` > 1990", 330, 19),
+        ("SELECT * FROM $astronauts WHERE `year` > 1990 OR `year` IS NULL", 162, 19),
+        ("SELECT * FROM $astronauts WHERE `year` <> 1996", 295, 19),
+        ("SELECT * FROM $astronauts WHERE `year` != 1996", 295, 19),
+        ("SELECT * FROM $astronauts WHERE NOT (`year` = 1996)", 295, 19),
         ("SELECT * FROM tests.data.formats.parquet WITH(NO_PARTITION) WHERE user_verified IS TRUE", 711, 13),
         ("SELECT * FROM tests.data.formats.parquet WITH(NO_PARTITION) WHERE user_verified IS FALSE", 99289, 13),
 
@@ -323,9 +352,21 @@ STATEMENTS = [
         ("SELECT name FROM $planets WHERE id IN (SELECT * FROM UNNEST((1,2,3)) as id)", 3, 1),
         ("SELECT count(planetId) FROM (SELECT DISTINCT planetId FROM $satellites)", 1, 1),
         ("SELECT COUNT(*) FROM (SELECT planetId FROM $satellites WHERE planetId < 7) GROUP BY planetId", 4, 1),
+        ("SELECT COUNT(*), planetId FROM (SELECT * FROM $satellites ORDER BY planetId) GROUP BY planetId", 7, 2),
+        ("SELECT MAX(id), planetId, name FROM (SELECT * FROM $satellites ORDER BY planetId, name) GROUP BY planetId, name", 177, 3),
+        ("SELECT AVG(gm), planetId FROM (SELECT * FROM $satellites ORDER BY planetId LIMIT 10) GROUP BY planetId", 3, 2),
+        ("SELECT COUNT(DISTINCT planetId) FROM $satellites", 1, 1),
+        ("SELECT COUNT(DISTINCT gm), planetId FROM $satellites GROUP BY planetId", 7, 2),
+        ("SELECT COUNT(DISTINCT gm), COUNT(*), planetId FROM $satellites GROUP BY planetId", 7, 3),
+        ("SELECT planetId, COUNT(*) FROM $satellites GROUP BY ROLLUP (planetId)", 8, 2),
+        ("SELECT planetId, COUNT(*) FROM $satellites GROUP BY CUBE (planetId)", 8, 2),
+        ("SELECT planetId, COUNT(*) FROM $satellites GROUP BY GROUPING SETS ((planetId), ())", 8, 2),
+        ("SELECT planetId, radius, COUNT(*) FROM $satellites GROUP BY ROLLUP (planetId, radius)", 119, 3),
 
         ("EXPLAIN SELECT * FROM $satellites", 1, 3),
         ("EXPLAIN SELECT * FROM $satellites WHERE id = 8", 2, 3),
+        ("EXPLAIN SELECT * FROM $satellites ORDER BY gm DESC LIMIT 10", 3, 3),
+        ("EXPLAIN ANALYZE SELECT * FROM $satellites WHERE id > 8 AND planetId = 5", 2, 3),
 
         ("SHOW COLUMNS FROM $satellites", 8, 2),
         ("SHOW FULL COLUMNS FROM $satellites", 8, 6),
@@ -396,6 +437,9 @@ STATEMENTS = [
         ("SELECT name, SEARCH(birth_place, 'Italy') FROM $astronauts", 357, 2),
         ("SELECT name, birth_place FROM $astronauts WHERE SEARCH(birth_place, 'Italy')", 1, 2),
         ("SELECT name, birth_place FROM $astronauts WHERE SEARCH(birth_place, 'Rome')", 1, 2),
+        ("SELECT name FROM $satellites WHERE SEARCH(name, 'al') OR SEARCH(name, 'io')", 23, 1),
+        ("SELECT name FROM $astronauts WHERE SEARCH(missions, 'Apollo 11') OR SEARCH(missions, 'Apollo 12')", 6, 1),
+        ("SELECT * FROM $satellites WHERE name LIKE '%al%' OR name LIKE 'Io%' OR name LIKE '%s'", 37, 8),
 
         ("SELECT EXTRACT(year FROM birth_date) AS birth_year FROM $astronauts WHERE birth_year < 1930;", 14, 1),
         ("SELECT EXTRACT(month FROM birth_date) FROM $astronauts", 357, 1),
@@ -428,6 +472,10 @@ STATEMENTS = [
         ("SELECT * FROM $planets LEFT JOIN $satellites ON $satellites.planetId = $planets.id WHERE $satellites.name = NONE", 2, 28),
         # SORT BROKEN
         ("SELECT * FROM (SELECT * FROM $planets ORDER BY id DESC LIMIT 5) WHERE id > 7", 2, 20),
+        ("SELECT name FROM $satellites ORDER BY gm DESC LIMIT 10", 10, 1),
+        ("SELECT name FROM $satellites ORDER BY gm DESC LIMIT 10 OFFSET 170", 7, 1),
+        ("SELECT name FROM $satellites ORDER BY planetId, name LIMIT 0", 0, 1),
+        ("SELECT name FROM $satellites ORDER BY RANDOM() LIMIT 3", 3, 1),
         # ORDER OF JOIN CONDITION
         ("SELECT * FROM $planets INNER JOIN $satellites ON $satellites.planetId = $planets.id", 177, 28),
         # ORDER BY QUALIFIED IDENTIFIER
@@ -450,7 +498,7 @@ STATEMENTS = [
         ("SELECT * FROM tests.data.nulls WHERE username LIKE 'BBC%' FOR '2000-01-01'", 3, 5),
         ("SELECT * FROM tests.data.nulls WHERE username ILIKE 'BBC%' FOR '2000-01-01'", 3, 5),
         ("SELECT * FROM tests.data.nulls WHERE username NOT LIKE 'BBC%' FOR '2000-01-01'", 21, 5),
-        ("SELECT * FROM tests.data.nulls WHERE NOT username LIKE 'BBC%' FOR '2000-01-01'", 22, 5),
+        ("SELECT * FROM tests.data.nulls WHERE NOT username LIKE 'BBC%' FOR '2000-01-01'", 21, 5),
         ("SELECT * FROM tests.data.nulls WHERE username NOT ILIKE 'BBC%' FOR '2000-01-01'", 21, 5),
         ("SELECT * FROM tests.data.nulls WHERE username ~ 'BBC.+' FOR '2000-01-01'", 3, 5),
         ("SELECT * FROM tests.data.nulls WHERE tweet ILIKE '%Trump%' FOR '2000-01-01'", 0, 5),